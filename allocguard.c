@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Gancho de teste que intercepta malloc/free. Carregado com LD_PRELOAD,
+// conta as chamadas feitas por qualquer thread (jogo, desenho, áudio,
+// logger) entre alloc_guard_begin() e alloc_guard_end() (o jogo chama ao
+// começar e ao sair do laço da música) e termina o processo com status 1
+// se houver alguma (2 se nenhuma música chegou a tocar). O status 2 só
+// vale no jogo, que se anuncia com alloc_guard_expect(); outros processos
+// do mesmo LD_PRELOAD (timeout, env, o shell) saem como sairiam:
+//
+//   gcc -shared -fPIC -o allocguard.so allocguard.c
+//   LD_PRELOAD=./allocguard.so ./guitar_hero3
+//
+// Com GH_ALLOC_GUARD=abort a primeira chamada proibida aborta na hora,
+// para ver no gdb de onde veio.
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static int armed = 0;            // Do processo: vale para todas as threads
+static __thread int inside = 0;  // fprintf pode alocar: não conta a si mesmo
+static unsigned long violations = 0;
+static unsigned long songs = 0;  // Músicas conferidas (alloc_guard_begin)
+static int expected = 0;         // Processo do jogo (alloc_guard_expect)
+
+static int is_armed(void) {
+    return __atomic_load_n(&armed, __ATOMIC_RELAXED);
+}
+
+static void violation(const char *what, size_t size) {
+    if (inside) return;
+    inside = 1;
+    __atomic_fetch_add(&violations, 1, __ATOMIC_RELAXED);
+
+    char msg[96];
+    int len = snprintf(msg, sizeof(msg), "allocguard: %s(%zu) durante a musica\n", what, size);
+    write(STDERR_FILENO, msg, len);
+
+    const char *mode = getenv("GH_ALLOC_GUARD");
+    if (mode != NULL && strcmp(mode, "abort") == 0) abort();
+    inside = 0;
+}
+
+void *malloc(size_t size) {
+    if (is_armed()) violation("malloc", size);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size) {
+    if (is_armed()) violation("calloc", n * size);
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    if (is_armed()) violation("realloc", size);
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) {
+    if (is_armed() && ptr != NULL) violation("free", 0);
+    __libc_free(ptr);
+}
+
+void alloc_guard_expect(void) {
+    expected = 1;
+}
+
+void alloc_guard_begin(void) {
+    __atomic_store_n(&armed, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&songs, 1, __ATOMIC_RELAXED);
+}
+
+void alloc_guard_end(void) {
+    __atomic_store_n(&armed, 0, __ATOMIC_RELAXED);
+}
+
+// Resultado do teste no fim do processo. Sem nenhuma música tocada o
+// teste não conferiu nada: no jogo, status 2, para um roteiro quebrado
+// não passar
+__attribute__((destructor))
+static void alloc_guard_report(void) {
+    char msg[96];
+    int len;
+    if (violations > 0) {
+        len = snprintf(msg, sizeof(msg), "allocguard: FALHOU, %lu alocacoes no laco da musica\n", violations);
+        write(STDERR_FILENO, msg, len);
+        _exit(1);
+    }
+    if (!expected) return;
+    if (songs == 0) {
+        len = snprintf(msg, sizeof(msg), "allocguard: nenhuma musica conferida\n");
+        write(STDERR_FILENO, msg, len);
+        _exit(2);
+    }
+    len = snprintf(msg, sizeof(msg), "allocguard: ok, %lu musicas sem alocacao\n", songs);
+    write(STDERR_FILENO, msg, len);
+}
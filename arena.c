@@ -0,0 +1,47 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "arena.h"
+#include "logger.h"
+
+// Garante pelo menos size bytes livres. Só realoca se a arena atual for
+// pequena; o bloco é pré-tocado para não haver page fault durante a música
+int arena_reserve(Arena *arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    arena->used = 0;
+    if (arena->base != NULL && arena->size >= size) return 0;
+
+    arena_release(arena);
+    void *base = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (base == MAP_FAILED) {
+        lg_perror("Falha ao reservar arena");
+        return -1;
+    }
+    arena->base = base;
+    arena->size = size;
+    return 0;
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    if (arena->base == NULL || size > arena->size - arena->used) {
+        lg_error("Arena esgotada (%zu de %zu bytes)", arena->used + size, arena->size);
+        return NULL;
+    }
+    void *p = arena->base + arena->used;
+    arena->used += size;
+    return p;
+}
+
+void arena_reset(Arena *arena) {
+    arena->used = 0;
+}
+
+void arena_release(Arena *arena) {
+    if (arena->base != NULL) munmap(arena->base, arena->size);
+    arena->base = NULL;
+    arena->size = arena->used = 0;
+}
@@ -0,0 +1,30 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// Arena de uma música: um bloco só, reservado ao carregar a música, de onde
+// saem a partitura e o pool de notas. Nada é liberado individualmente;
+// arena_reset devolve tudo de uma vez para a próxima música.
+
+#define ARENA_ALIGN 16
+
+typedef struct {
+    unsigned char *base;
+    size_t size;
+    size_t used;
+} Arena;
+
+int arena_reserve(Arena *arena, size_t size);
+void *arena_alloc(Arena *arena, size_t size);
+void arena_reset(Arena *arena);
+void arena_release(Arena *arena);
+
+// Gancho de teste: allocguard.so (LD_PRELOAD) define estas funções e
+// falha se houver malloc/free entre begin e end. Sem ele ficam nulas.
+// expect marca o processo como o jogo conferido
+void alloc_guard_expect(void) __attribute__((weak));
+void alloc_guard_begin(void) __attribute__((weak));
+void alloc_guard_end(void) __attribute__((weak));
+
+#endif
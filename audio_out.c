@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <pthread.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/soundcard.h>
+
+#include "audio_out.h"
+#include "stretch.h"
+#include "rt.h"
+#include "trace.h"
+#include "logger.h"
+
+static int out_fd = -1;
+static bool is_dsp = false;
+static uint64_t latency_ns = 0;
+
+// Música tocando; start_ns e paused mudam com a thread rodando
+static pthread_t thread;
+static bool running = false;
+static bool stopping = false;
+static bool paused = false;
+static uint64_t start_ns = 0;
+static uint64_t offset_ns = 0;
+static int speed_pct = 100;
+static int rate = 44100;
+static Stretch st;
+
+// Custo do WSOLA por bloco, para comparar com a duração do bloco
+static uint64_t blocks = 0;
+static uint64_t render_sum_ns = 0;
+static uint64_t render_max_ns = 0;
+static uint64_t late_blocks = 0;
+static uint64_t dropped_blocks = 0;  // Destino cheio: bloco (ou o resto) descartado
+static uint64_t block_ns = 0;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Abre o destino (NULL = GH_AUDIO). Sem destino o jogo fica mudo
+int au_open(const char *path) {
+    if (path == NULL) path = getenv("GH_AUDIO");
+    if (path == NULL) return 0;
+
+    const char *lat = getenv("GH_AUDIO_LATENCY_MS");
+    if (lat != NULL) latency_ns = (uint64_t)atoi(lat) * 1000000ull;
+
+    // Sem bloquear: FIFO sem leitor falha aqui em vez de travar o jogo, e
+    // com o destino lento o bloco é descartado em vez de atrasar a thread.
+    // Em /dev só abre o que existe: um nome de dispositivo digitado errado
+    // não pode virar arquivo. Fora dele um arquivo comum é criado ou
+    // truncado
+    int flags = O_WRONLY | O_NONBLOCK;
+    if (strncmp(path, "/dev/", 5) != 0) flags |= O_CREAT;
+    out_fd = open(path, flags, 0644);
+    if (out_fd < 0) {
+        lg_postf(LG_WARN, errno, "Saida de audio %s indisponivel", path);
+        return -1;
+    }
+    struct stat st_out;
+    if (fstat(out_fd, &st_out) == 0 && S_ISREG(st_out.st_mode) && ftruncate(out_fd, 0) < 0) {
+        lg_postf(LG_WARN, errno, "Falha ao truncar %s", path);
+    }
+    is_dsp = fstat(out_fd, &st_out) == 0 && S_ISCHR(st_out.st_mode);
+    if (is_dsp) {
+        int fmt = AFMT_S16_LE, channels = 1;
+        if (ioctl(out_fd, SNDCTL_DSP_SETFMT, &fmt) < 0 || ioctl(out_fd, SNDCTL_DSP_CHANNELS, &channels) < 0) {
+            lg_post(LG_WARN, errno, "Dispositivo de audio nao aceita PCM 16 bits mono");
+        }
+    }
+    // Leitor do FIFO fechou: write falha com EPIPE em vez de matar o jogo
+    signal(SIGPIPE, SIG_IGN);
+    return 0;
+}
+
+bool au_enabled(void) {
+    return out_fd >= 0;
+}
+
+// Escreve um bloco inteiro. Destino cheio logo de cara: o bloco é
+// descartado. Escrita parcial: espera o destino aceitar o resto por até
+// um bloco, para não deixar meia amostra no fluxo; se nem assim, descarta
+static void write_block(const int16_t *pcm) {
+    const char *p = (const char *)pcm;
+    size_t len = ST_HOP * sizeof(int16_t), done = 0;
+    while (done < len) {
+        ssize_t n = write(out_fd, p + done, len - done);
+        if (n > 0) {
+            done += n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && errno != EAGAIN) {
+            lg_post(LG_WARN, errno, "Falha na saida de audio");
+            return;
+        }
+        struct pollfd pfd = { .fd = out_fd, .events = POLLOUT };
+        if (done == 0 || poll(&pfd, 1, (int)(block_ns / 1000000) + 1) <= 0) {
+            dropped_blocks++;
+            return;
+        }
+    }
+}
+
+static void *au_thread(void *arg) {
+    (void)arg;
+    rt_enter_thread(RT_AUDIO);
+    tr_thread("audio");
+
+    float block[ST_HOP];
+    int16_t pcm[ST_HOP];
+    uint64_t next = now_ns();
+
+    while (!__atomic_load_n(&stopping, __ATOMIC_ACQUIRE)) {
+        tr_begin("audio_block");
+        uint64_t t0 = now_ns();
+        uint64_t start = __atomic_load_n(&start_ns, __ATOMIC_ACQUIRE);
+        uint64_t heard = next + latency_ns;
+
+        if (__atomic_load_n(&paused, __ATOMIC_ACQUIRE) || heard < start) {
+            memset(block, 0, sizeof(block));
+            st_reset(&st);
+        } else {
+            // Posição na entrada do que vai soar em heard: o relógio da
+            // música anda speed_pct% do normal
+            double song_ns = (double)(heard - start) * speed_pct / 100.0 - (double)offset_ns;
+            st_render(&st, song_ns * rate / 1e9, block);
+        }
+        for (int i = 0; i < ST_HOP; i++) {
+            float v = block[i] * 32767.0f;
+            pcm[i] = v > 32767.0f ? 32767 : (v < -32768.0f ? -32768 : (int16_t)v);
+        }
+
+        uint64_t spent = now_ns() - t0;
+        blocks++;
+        render_sum_ns += spent;
+        if (spent > render_max_ns) render_max_ns = spent;
+        tr_end("audio_block");
+        write_block(pcm);
+
+        next += block_ns;
+        uint64_t now = now_ns();
+        if (next < now) {
+            // Atrasou um bloco inteiro: retoma do relógio em vez de correr
+            late_blocks++;
+            next = now;
+        }
+        struct timespec ts = { next / 1000000000, next % 1000000000 };
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+    }
+    return NULL;
+}
+
+// Toca audio a partir do instante monotônico start (tempo zero da
+// música); o áudio começa offset depois, no tempo da música
+int au_play(const Audio *audio, uint64_t start, uint64_t offset, int speed) {
+    au_stop();
+    if (out_fd < 0 || audio->count == 0) return -1;
+
+    rate = audio->rate;
+    if (is_dsp && ioctl(out_fd, SNDCTL_DSP_SPEED, &rate) < 0) rate = audio->rate;
+    block_ns = (uint64_t)ST_HOP * 1000000000ull / rate;
+    st_init(&st, audio->samples, audio->count);
+    start_ns = start;
+    offset_ns = offset;
+    speed_pct = speed;
+    paused = false;
+    stopping = false;
+
+    int err = pthread_create(&thread, NULL, au_thread, NULL);
+    if (err) {
+        lg_post(LG_ERROR, err, "Falha ao criar thread de audio");
+        return -1;
+    }
+    running = true;
+    return 0;
+}
+
+// Depois de uma pausa o jogo desloca o tempo zero; o áudio acompanha
+void au_set_start(uint64_t start) {
+    __atomic_store_n(&start_ns, start, __ATOMIC_RELEASE);
+}
+
+void au_pause(bool on) {
+    __atomic_store_n(&paused, on, __ATOMIC_RELEASE);
+}
+
+void au_stop(void) {
+    if (!running) return;
+    __atomic_store_n(&stopping, true, __ATOMIC_RELEASE);
+    pthread_join(thread, NULL);
+    running = false;
+}
+
+void au_close(void) {
+    au_stop();
+    if (out_fd >= 0) close(out_fd);
+    out_fd = -1;
+}
+
+void au_report(void) {
+    if (blocks == 0) return;
+    printf("Audio: %llu blocos de %lluus; WSOLA medio %lluus, max %lluus; %llu atrasados, %llu descartados\n",
+           (unsigned long long)blocks, (unsigned long long)(block_ns / 1000),
+           (unsigned long long)(render_sum_ns / blocks / 1000),
+           (unsigned long long)(render_max_ns / 1000), (unsigned long long)late_blocks,
+           (unsigned long long)dropped_blocks);
+}
@@ -0,0 +1,29 @@
+#ifndef AUDIO_OUT_H
+#define AUDIO_OUT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "onset.h"
+
+// Saída de áudio da música numa thread própria. A cada bloco (ST_HOP
+// amostras) a thread lê o relógio da música, pede ao WSOLA o trecho
+// correspondente e escreve PCM de 16 bits mono. O destino vem de GH_AUDIO:
+// um dispositivo OSS (/dev/dsp, configurado aqui) ou qualquer outro
+// caminho (FIFO para o aplay, arquivo) que receba o PCM cru:
+//
+//   mkfifo /tmp/gh.pcm; aplay -f S16_LE -c 1 -r 44100 /tmp/gh.pcm &
+//   GH_AUDIO=/tmp/gh.pcm ./guitar_hero3
+//
+// GH_AUDIO_LATENCY_MS compensa o buffer do destino (padrão 0).
+
+int au_open(const char *path);
+void au_close(void);
+bool au_enabled(void);
+int au_play(const Audio *audio, uint64_t start_ns, uint64_t offset_ns, int speed_pct);
+void au_set_start(uint64_t start_ns);
+void au_pause(bool paused);
+void au_stop(void);
+void au_report(void);
+
+#endif
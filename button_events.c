@@ -0,0 +1,292 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <string.h>
+#include <poll.h>
+#include <linux/joystick.h>
+
+#include "button_events.h"
+#include "logger.h"
+
+static int event_fd = -1;
+static int key_fd = -1;
+static int key_flags = -1;           // Flags originais do teclado
+static unsigned long (*poll_buttons)(void) = NULL;
+static uint32_t last_buttons = 0;
+static int watch_fd = -1;
+static bool (*on_watch)(void) = NULL;
+
+// Joystick: bordas dos botões numa fila, eixos só com o último valor
+static int joy_fd = -1;
+static uint32_t joy_buttons = 0;     // Estado depois da última borda lida
+static uint32_t joy_reported = 0;    // Estado do último evento entregue
+static BeRecord joy_edges[BE_JS_QUEUE];
+static unsigned edge_head = 0, edge_tail = 0;
+static int16_t axis_raw[BE_MAX_AXES];
+static int16_t axis_filtered[BE_MAX_AXES];
+static unsigned axis_events = 0;
+
+// Registro parcial (sockets de fluxo podem entregar pedaços)
+static unsigned char pending[sizeof(BeRecord)];
+static size_t pending_len = 0;
+
+uint64_t be_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Usa um fd já aberto como fonte (ex.: socketpair em testes)
+int be_attach(int fd, unsigned long (*read_buttons)(void)) {
+    poll_buttons = read_buttons;
+    event_fd = fd;
+    pending_len = 0;
+    if (fd >= 0) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+    return 0;
+}
+
+// Abre a fonte de eventos; sem caminho, usa GH_BUTTON_EVENTS. Se nada
+// estiver disponível, fica no polling por ioctl
+int be_open(const char *event_path, unsigned long (*read_buttons)(void)) {
+    if (event_path == NULL) event_path = getenv("GH_BUTTON_EVENTS");
+
+    int fd = -1;
+    if (event_path != NULL) {
+        fd = open(event_path, O_RDONLY | O_NONBLOCK);
+        if (fd < 0) {
+            lg_postf(LG_WARN, errno, "Fonte de eventos %s indisponivel, usando polling", event_path);
+        }
+    }
+    return be_attach(fd, read_buttons);
+}
+
+// Teclado (terminal em modo não canônico) na mesma espera dos botões.
+// As teclas 1-8 valem como aperto da pista correspondente
+// O fd fica sem bloquear: VMIN=0 só vale para terminal, e com a entrada
+// num FIFO, pipe ou socket o read travaria a espera até a próxima tecla.
+// be_close devolve as flags originais
+static void release_keyboard(void) {
+    if (key_fd >= 0 && key_flags >= 0) fcntl(key_fd, F_SETFL, key_flags);
+    key_fd = -1;
+    key_flags = -1;
+}
+
+void be_set_keyboard(int fd) {
+    release_keyboard();
+    key_fd = fd;
+    if (fd < 0) return;
+    key_flags = fcntl(fd, F_GETFL);
+    if (key_flags < 0 || fcntl(fd, F_SETFL, key_flags | O_NONBLOCK) < 0) {
+        lg_post(LG_WARN, errno, "Teclado sem O_NONBLOCK");
+    }
+}
+
+// Outro descritor atendido na mesma espera (ex.: o socket do versus).
+// on_ready roda quando ele fica legível; se retornar true, be_wait volta
+// como se fosse timeout
+void be_watch(int fd, bool (*on_ready)(void)) {
+    watch_fd = fd;
+    on_watch = on_ready;
+}
+
+// Controle USB (/dev/input/jsN, ou GH_JOYSTICK). Os botões 0-7 valem
+// como as pistas; os eixos (alavanca, inclinação) ficam em be_axes. Sem o
+// dispositivo nada muda
+int be_open_joystick(const char *path) {
+    bool asked = path != NULL || getenv("GH_JOYSTICK") != NULL;
+    if (path == NULL) path = getenv("GH_JOYSTICK");
+    if (path == NULL) path = BE_JOYSTICK;
+
+    joy_fd = open(path, O_RDONLY | O_NONBLOCK);
+    if (joy_fd < 0) {
+        if (asked) lg_postf(LG_WARN, errno, "Joystick %s indisponivel", path);
+        return -1;
+    }
+    return 0;
+}
+
+void be_close(void) {
+    if (event_fd >= 0) close(event_fd);
+    event_fd = -1;
+    if (joy_fd >= 0) close(joy_fd);
+    joy_fd = -1;
+    release_keyboard();
+}
+
+static void make_event(ButtonEvent *ev, uint64_t time_ns, uint32_t buttons) {
+    ev->time_ns = time_ns;
+    ev->buttons = buttons;
+    ev->changes = buttons ^ last_buttons;
+    ev->key = 0;
+    last_buttons = buttons;
+}
+
+// Tenta tirar um registro da fonte. 1 com evento, 0 se não há dados
+static int read_record(ButtonEvent *ev) {
+    for (;;) {
+        ssize_t n = read(event_fd, pending + pending_len, sizeof(pending) - pending_len);
+        if (n > 0) {
+            pending_len += n;
+            if (pending_len < sizeof(pending)) continue;
+
+            BeRecord rec;
+            memcpy(&rec, pending, sizeof(rec));
+            pending_len = 0;
+            make_event(ev, rec.time_ns ? rec.time_ns : be_now_ns(), rec.buttons);
+            return 1;
+        }
+        if (n == 0) {
+            // Escritor fechou: volta para o polling em vez de girar no
+            // POLLHUP. Só esta fonte; o joystick continua aberto
+            lg_warn("Fonte de eventos encerrada, usando polling");
+            close(event_fd);
+            event_fd = -1;
+            pending_len = 0;
+            return 0;
+        }
+        if (errno == EINTR) continue;
+        return 0;
+    }
+}
+
+// Esvazia o joystick em lotes de BE_JS_BATCH por read(). Eixos só
+// sobrescrevem o último valor; bordas de botão vão para a fila, que nunca
+// perde uma: com ela cheia o resto fica no kernel para a próxima vez
+static void drain_joystick(void) {
+    struct js_event batch[BE_JS_BATCH];
+    while (joy_fd >= 0 && edge_tail - edge_head <= BE_JS_QUEUE - BE_JS_BATCH) {
+        ssize_t n = read(joy_fd, batch, sizeof(batch));
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) continue;
+            if (n == 0 || errno != EAGAIN) {
+                lg_post(LG_WARN, n ? errno : 0, "Joystick desconectado");
+                close(joy_fd);
+                joy_fd = -1;
+            }
+            return;
+        }
+
+        uint64_t now = be_now_ns();
+        for (int i = 0; i < (int)(n / sizeof(batch[0])); i++) {
+            const struct js_event *e = &batch[i];
+            // Os eventos JS_EVENT_INIT trazem o estado na abertura
+            int type = e->type & ~JS_EVENT_INIT;
+            if (type == JS_EVENT_AXIS && e->number < BE_MAX_AXES) {
+                axis_raw[e->number] = e->value;
+                if (e->type & JS_EVENT_INIT) axis_filtered[e->number] = e->value;
+                axis_events++;
+            } else if (type == JS_EVENT_BUTTON && e->number < 32 && !(e->type & JS_EVENT_INIT)) {
+                BeRecord *r = &joy_edges[edge_tail++ % BE_JS_QUEUE];
+                r->time_ns = now;
+                r->buttons = e->value ? joy_buttons | (1u << e->number) : joy_buttons & ~(1u << e->number);
+                joy_buttons = r->buttons;
+            }
+        }
+        if (n < (ssize_t)sizeof(batch)) return;
+    }
+}
+
+static int read_joystick(ButtonEvent *ev) {
+    if (edge_head == edge_tail) drain_joystick();
+    if (edge_head == edge_tail) return 0;
+
+    const BeRecord *r = &joy_edges[edge_head % BE_JS_QUEUE];
+    ev->time_ns = r->time_ns;
+    ev->buttons = r->buttons;
+    ev->changes = r->buttons ^ joy_reported;
+    ev->key = 0;
+    joy_reported = r->buttons;
+    edge_head++;
+    return 1;
+}
+
+// Valores dos eixos para o quadro: o último de cada um desde a chamada
+// anterior, suavizado (média exponencial de meio a meio) e com zona morta
+// em volta do centro. Lê o que houver no joystick sem esperar
+void be_axes(BeAxes *out) {
+    drain_joystick();
+    for (int i = 0; i < BE_MAX_AXES; i++) {
+        axis_filtered[i] += (axis_raw[i] - axis_filtered[i]) / 2;
+        int v = axis_filtered[i];
+        out->value[i] = (v > -BE_AXIS_DEADZONE && v < BE_AXIS_DEADZONE) ? 0 : v;
+    }
+    out->coalesced = axis_events;
+    out->present = joy_fd >= 0;
+    axis_events = 0;
+}
+
+static int read_key(ButtonEvent *ev) {
+    unsigned char c;
+    ssize_t n = read(key_fd, &c, 1);
+    if (n == 0 && !isatty(key_fd)) release_keyboard(); // EOF de pipe/arquivo
+    if (n != 1) return 0;
+
+    ev->time_ns = be_now_ns();
+    ev->buttons = last_buttons;
+    ev->changes = 0;
+    ev->key = c;
+    if (c >= '1' && c <= '8') {
+        // Aperto sintético: não altera o estado guardado da placa
+        uint32_t bit = 1u << (c - '1');
+        ev->buttons |= bit;
+        ev->changes = bit;
+    }
+    return 1;
+}
+
+// Espera a próxima mudança dos botões ou tecla até o instante monotônico
+// deadline_ns (0 espera para sempre), com resolução de nanossegundos.
+// Retorna 1 com evento, 0 no prazo ou pelo be_watch, -1 em erro ou sinal
+int be_wait_until(ButtonEvent *ev, uint64_t deadline_ns) {
+    for (;;) {
+        if (event_fd >= 0) {
+            if (read_record(ev)) return 1;
+        } else if (poll_buttons != NULL) {
+            uint32_t buttons = (uint32_t)poll_buttons();
+            if (buttons != last_buttons) {
+                make_event(ev, be_now_ns(), buttons);
+                return 1;
+            }
+        }
+        if (key_fd >= 0 && read_key(ev)) return 1;
+        if (read_joystick(ev)) return 1;
+
+        uint64_t wait_ns = UINT64_MAX;
+        if (deadline_ns != 0) {
+            uint64_t now = be_now_ns();
+            if (now >= deadline_ns) return 0;
+            wait_ns = deadline_ns - now;
+        }
+        // Sem fonte de eventos a placa só é vista pelo ioctl
+        if (event_fd < 0 && poll_buttons != NULL && wait_ns > BE_FALLBACK_MS * 1000000ull) {
+            wait_ns = BE_FALLBACK_MS * 1000000ull;
+        }
+        struct timespec ts = { (time_t)(wait_ns / 1000000000ull), (long)(wait_ns % 1000000000ull) };
+
+        struct pollfd pfds[4];
+        int nfds = 0;
+        if (event_fd >= 0) pfds[nfds++] = (struct pollfd){ .fd = event_fd, .events = POLLIN };
+        if (key_fd >= 0) pfds[nfds++] = (struct pollfd){ .fd = key_fd, .events = POLLIN };
+        if (joy_fd >= 0) pfds[nfds++] = (struct pollfd){ .fd = joy_fd, .events = POLLIN };
+        int watch = -1;
+        if (watch_fd >= 0) {
+            watch = nfds;
+            pfds[nfds++] = (struct pollfd){ .fd = watch_fd, .events = POLLIN };
+        }
+
+        if (ppoll(pfds, nfds, wait_ns == UINT64_MAX ? NULL : &ts, NULL) < 0) return -1;
+        if (watch >= 0 && (pfds[watch].revents & POLLIN) && on_watch()) return 0;
+    }
+}
+
+// O mesmo com prazo relativo em ms; timeout_ms < 0 espera para sempre
+int be_wait(ButtonEvent *ev, int timeout_ms) {
+    if (timeout_ms < 0) return be_wait_until(ev, 0);
+    return be_wait_until(ev, be_now_ns() + (uint64_t)timeout_ms * 1000000ull);
+}
@@ -0,0 +1,52 @@
+#ifndef BUTTON_EVENTS_H
+#define BUTTON_EVENTS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Botões da placa como fluxo de eventos. Com uma fonte de eventos (nó do
+// driver, FIFO ou socket) o jogo dorme em poll() até chegar um registro;
+// sem ela, cai no polling por ioctl de antes. O teclado e o joystick, se
+// registrados, entram na mesma espera.
+
+#define BE_FALLBACK_MS 10     // Intervalo do polling por ioctl
+#define BE_JOYSTICK "/dev/input/js0"
+#define BE_JS_BATCH 64        // Eventos do joystick por read()
+#define BE_JS_QUEUE 256       // Bordas de botão à espera (múltiplo do lote)
+#define BE_MAX_AXES 8
+#define BE_AXIS_DEADZONE 1500 // De 32767
+
+// Registro no fio: o driver (ou o substituto de teste) escreve exatamente
+// este struct a cada mudança
+typedef struct {
+    uint64_t time_ns;         // CLOCK_MONOTONIC da borda
+    uint32_t buttons;         // Estado atual de todos os botões
+    uint32_t reserved;
+} BeRecord;
+
+typedef struct {
+    uint64_t time_ns;
+    uint32_t buttons;
+    uint32_t changes;         // Bits que mudaram desde o último evento
+    int key;                  // Tecla lida do teclado, 0 se veio da placa
+} ButtonEvent;
+
+// Eixos do joystick, um valor por quadro
+typedef struct {
+    int16_t value[BE_MAX_AXES];
+    unsigned coalesced;       // Eventos de eixo absorvidos desde o último
+    bool present;
+} BeAxes;
+
+int be_open(const char *event_path, unsigned long (*read_buttons)(void));
+int be_attach(int fd, unsigned long (*read_buttons)(void));
+void be_set_keyboard(int fd);
+int be_open_joystick(const char *path);
+void be_axes(BeAxes *out);
+void be_watch(int fd, bool (*on_ready)(void));
+int be_wait(ButtonEvent *ev, int timeout_ms);
+int be_wait_until(ButtonEvent *ev, uint64_t deadline_ns);
+void be_close(void);
+uint64_t be_now_ns(void);
+
+#endif
@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <linux/joystick.h>
+
+#include "button_events.h"
+
+// Teste do button_events sem a placa: um socketpair faz o papel do nó de
+// eventos do driver (be_attach) e um FIFO o do joystick. Sai com status 1
+// se algo falhar.
+
+static int failures = 0;
+
+#define CHECK(cond, msg) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FALHOU: %s (%s:%d)\n", msg, __FILE__, __LINE__); \
+        failures++; \
+    } \
+} while (0)
+
+static void send_bytes(int fd, const void *data, size_t len) {
+    if (write(fd, data, len) != (ssize_t)len) {
+        perror("write");
+        exit(1);
+    }
+}
+
+static BeRecord record(uint64_t time_ns, uint32_t buttons) {
+    BeRecord r = { .time_ns = time_ns, .buttons = buttons };
+    return r;
+}
+
+int main(void) {
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+        perror("socketpair");
+        return 1;
+    }
+    be_attach(sv[0], NULL);
+    ButtonEvent ev;
+
+    // Registro inteiro: estado e bordas
+    BeRecord r = record(1000, 0x5);
+    send_bytes(sv[1], &r, sizeof(r));
+    CHECK(be_wait(&ev, 100) == 1, "registro inteiro nao chegou");
+    CHECK(ev.time_ns == 1000 && ev.buttons == 0x5 && ev.changes == 0x5 && ev.key == 0,
+          "registro inteiro com campos errados");
+
+    // Registro em dois pedaços: o primeiro sozinho não vira evento
+    r = record(2000, 0x4);
+    send_bytes(sv[1], &r, 5);
+    CHECK(be_wait(&ev, 20) == 0, "pedaco de registro virou evento");
+    send_bytes(sv[1], (const char *)&r + 5, sizeof(r) - 5);
+    CHECK(be_wait(&ev, 100) == 1, "registro completado nao chegou");
+    CHECK(ev.time_ns == 2000 && ev.buttons == 0x4 && ev.changes == 0x1,
+          "registro em pedacos com campos errados");
+
+    // Dois registros numa escrita só saem em dois eventos, em ordem
+    BeRecord two[2] = { record(3000, 0x6), record(4000, 0x0) };
+    send_bytes(sv[1], two, sizeof(two));
+    CHECK(be_wait(&ev, 100) == 1 && ev.time_ns == 3000 && ev.changes == 0x2, "primeiro de dois");
+    CHECK(be_wait(&ev, 100) == 1 && ev.time_ns == 4000 && ev.changes == 0x6, "segundo de dois");
+
+    // Joystick num FIFO, aberto junto com a fonte de eventos
+    char js_path[64];
+    snprintf(js_path, sizeof(js_path), "/tmp/button_events_test.%d", (int)getpid());
+    if (mkfifo(js_path, 0600) < 0) {
+        perror("mkfifo");
+        return 1;
+    }
+    CHECK(be_open_joystick(js_path) == 0, "joystick nao abriu");
+    int js = open(js_path, O_WRONLY | O_NONBLOCK);
+    unlink(js_path);
+    if (js < 0) {
+        perror("open");
+        return 1;
+    }
+
+    // Escritor fechou: be_wait não pode girar no EOF nem inventar evento
+    close(sv[1]);
+    uint64_t start = be_now_ns();
+    CHECK(be_wait(&ev, 50) == 0, "EOF virou evento");
+    CHECK(be_now_ns() - start >= 45000000ull, "EOF fez be_wait voltar antes do prazo");
+    CHECK(be_wait(&ev, 10) == 0, "espera depois do EOF");
+
+    // O fim da fonte de eventos não pode levar o joystick junto
+    // (sem leitor o write falha com EPIPE em vez de matar o teste)
+    struct js_event press = { .time = 1, .value = 1, .type = JS_EVENT_BUTTON, .number = 2 };
+    signal(SIGPIPE, SIG_IGN);
+    CHECK(write(js, &press, sizeof(press)) == sizeof(press) && be_wait(&ev, 100) == 1,
+          "joystick fechado junto com a fonte de eventos");
+    CHECK(ev.buttons == 0x4 && ev.changes == 0x4, "aperto do joystick com campos errados");
+
+    close(js);
+    be_close();
+    if (failures == 0) printf("button_events: ok\n");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chart.h"
+#include "logger.h"
+
+void chart_free(Chart *chart) {
+    for (int i = 0; i < chart->level_count; i++) free(chart->levels[i].notes);
+    memset(chart, 0, sizeof(*chart));
+}
+
+static int load_error(FILE *f, Chart *chart, Arena *arena, const char *path, const char *why) {
+    lg_postf(LG_ERROR, 0, "%s: %s", path, why);
+    fclose(f);
+    if (arena == NULL) chart_free(chart);
+    return -1;
+}
+
+int chart_load(const char *path, Chart *chart, Arena *arena) {
+    memset(chart, 0, sizeof(*chart));
+
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        lg_postf(LG_ERROR, errno, "Falha ao abrir partitura %s", path);
+        return -1;
+    }
+
+    char line[256];
+    if (fgets(line, sizeof(line), f) == NULL || strncmp(line, CHART_MAGIC, 4) != 0) {
+        return load_error(f, chart, arena, path, "nao e uma partitura " CHART_MAGIC);
+    }
+
+    ChartLevel *level = NULL;
+    int filled = 0;
+    while (fgets(line, sizeof(line), f) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+
+        unsigned time_ms, lane;
+        if (level != NULL && filled < level->count &&
+            sscanf(line, "%u %u", &time_ms, &lane) == 2) {
+            // O jogo (pool de notas, spawn) conta com as notas em ordem
+            if (filled > 0 && time_ms < level->notes[filled - 1].time_ms) {
+                return load_error(f, chart, arena, path, "notas fora de ordem");
+            }
+            level->notes[filled].time_ms = time_ms;
+            level->notes[filled].lane = lane;
+            filled++;
+        } else if (strncmp(line, "title ", 6) == 0) {
+            snprintf(chart->title, CHART_TITLE_LEN, "%.*s", CHART_TITLE_LEN - 1, line + 6);
+        } else if (sscanf(line, "bpm %f", &chart->bpm) == 1) {
+            continue;
+        } else if (sscanf(line, "lanes %d", &chart->lanes) == 1) {
+            continue;
+        } else if (strncmp(line, "level ", 6) == 0) {
+            if (level != NULL && filled < level->count) {
+                return load_error(f, chart, arena, path, "nivel incompleto");
+            }
+            if (chart->level_count >= CHART_MAX_LEVELS) {
+                return load_error(f, chart, arena, path, "niveis demais");
+            }
+            level = &chart->levels[chart->level_count];
+            if (sscanf(line + 6, "%15s %d", level->name, &level->count) != 2 || level->count < 0) {
+                return load_error(f, chart, arena, path, "cabecalho de nivel invalido");
+            }
+            size_t bytes = (level->count ? level->count : 1) * sizeof(ChartNote);
+            level->notes = arena ? arena_alloc(arena, bytes) : malloc(bytes);
+            if (level->notes == NULL) return load_error(f, chart, arena, path, "sem memoria");
+            level->offset = ftell(f);
+            chart->level_count++;
+            filled = 0;
+        }
+    }
+    fclose(f);
+
+    if (level == NULL || filled < level->count) {
+        lg_postf(LG_ERROR, 0, "%s: partitura incompleta", path);
+        if (arena == NULL) chart_free(chart);
+        return -1;
+    }
+    if (chart->lanes < 1) chart->lanes = 1;
+    return 0;
+}
+
+// Lê só as notas de um nível, a partir da posição guardada no índice da
+// biblioteca, sem passar pelo resto do arquivo
+int chart_read_level(const char *path, long offset, int count, ChartNote *notes) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        lg_postf(LG_ERROR, errno, "Falha ao abrir partitura %s", path);
+        return -1;
+    }
+
+    int n = 0;
+    unsigned time_ms, lane;
+    if (fseek(f, offset, SEEK_SET) == 0) {
+        while (n < count && fscanf(f, "%u %u", &time_ms, &lane) == 2) {
+            // O arquivo pode ter mudado depois de indexado
+            if (n > 0 && time_ms < notes[n - 1].time_ms) break;
+            notes[n].time_ms = time_ms;
+            notes[n].lane = lane;
+            n++;
+        }
+    }
+    fclose(f);
+
+    if (n < count) {
+        lg_postf(LG_ERROR, 0, "%s: nivel incompleto ou fora de ordem", path);
+        return -1;
+    }
+    return 0;
+}
+
+int chart_save(const char *path, const Chart *chart) {
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        lg_postf(LG_ERROR, errno, "Falha ao gravar partitura %s", path);
+        return -1;
+    }
+
+    fprintf(f, "%s\ntitle %s\nbpm %.2f\nlanes %d\n", CHART_MAGIC, chart->title, chart->bpm, chart->lanes);
+    for (int i = 0; i < chart->level_count; i++) {
+        const ChartLevel *level = &chart->levels[i];
+        fprintf(f, "level %s %d\n", level->name, level->count);
+        for (int n = 0; n < level->count; n++) {
+            fprintf(f, "%u %u\n", level->notes[n].time_ms, level->notes[n].lane);
+        }
+    }
+
+    if (fclose(f) != 0) {
+        lg_postf(LG_ERROR, errno, "Falha ao gravar partitura %s", path);
+        return -1;
+    }
+    return 0;
+}
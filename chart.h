@@ -0,0 +1,51 @@
+#ifndef CHART_H
+#define CHART_H
+
+#include <stdint.h>
+
+#include "arena.h"
+
+// Partitura de uma música, gerada pelo ghchart a partir do áudio e lida
+// pelo jogo. Arquivo texto, uma nota por linha:
+//
+//   GHC1
+//   title <nome da música>
+//   bpm <andamento estimado>
+//   lanes <pistas usadas>
+//   level <nome> <quantidade de notas>
+//   <tempo em ms> <pista>
+//   ...                      (um bloco level por dificuldade)
+
+#define CHART_MAGIC "GHC1"
+#define CHART_EXT ".chart"
+#define CHART_MAX_LEVELS 4
+#define CHART_TITLE_LEN 64
+#define CHART_LEVEL_LEN 16
+
+typedef struct {
+    uint32_t time_ms;         // Instante em que a nota cruza a linha
+    uint32_t lane;
+} ChartNote;
+
+typedef struct {
+    char name[CHART_LEVEL_LEN];
+    int count;
+    long offset;              // Posição da primeira nota no arquivo
+    ChartNote *notes;         // Em ordem de tempo
+} ChartLevel;
+
+typedef struct {
+    char title[CHART_TITLE_LEN];
+    float bpm;
+    int lanes;
+    int level_count;
+    ChartLevel levels[CHART_MAX_LEVELS];
+} Chart;
+
+// Com arena, as notas saem dela e a partitura não precisa de chart_free
+int chart_load(const char *path, Chart *chart, Arena *arena);
+int chart_read_level(const char *path, long offset, int count, ChartNote *notes);
+int chart_save(const char *path, const Chart *chart);
+void chart_free(Chart *chart);
+
+#endif
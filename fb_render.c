@@ -0,0 +1,418 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/fb.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "fb_render.h"
+#include "logger.h"
+
+typedef struct {
+    int x, y, w, h;
+} Rect;
+
+// Tela de destino: framebuffer mapeado ou imagem em memória
+static uint32_t *front = NULL;
+static int width, height, stride;   // stride em pixels
+static int fb_fd = -1;
+static void *fb_map = MAP_FAILED;
+static size_t fb_map_len = 0;
+static char ppm_path[256];
+static int red_shift = 16, green_shift = 8, blue_shift = 0;
+
+// Fundo estático e buffer de composição, ambos width x height
+static uint32_t *bg = NULL, *back = NULL;
+
+// Geometria da pista, recalculada quando o número de pistas muda
+static int layout_lanes = -1;
+static int lane_w, track_x, track_top, strike_y, note_h, hud_h;
+
+static Rect prev_rects[HW_MAX_NOTES];
+static int prev_lanes[HW_MAX_NOTES];
+static int prev_count = 0;
+static int shown_score = -1, shown_misses = -1;
+static int shown_peer = -2;     // -1 já é "sem adversário"
+static int shown_power = -2;
+static bool shown_active = false;
+static bool full_redraw = true;
+
+static const uint32_t lane_rgb[HW_MAX_LANES] = {
+    0x00C000, 0xE00000, 0xE0E000, 0x2040FF,
+    0xC000C0, 0x00C0C0, 0xE0E0E0, 0xFF8000
+};
+
+// Dígitos 3x5, uma linha de 3 bits por vez, de cima para baixo
+static const uint16_t digits[10] = {
+    0x7B6F, 0x2C97, 0x73E7, 0x73CF, 0x5BC9, 0x79CF, 0x79EF, 0x7249, 0x7BEF, 0x7BCF
+};
+
+static uint32_t pack(uint32_t rgb) {
+    return ((rgb >> 16) & 0xFF) << red_shift |
+           ((rgb >> 8) & 0xFF) << green_shift |
+           (rgb & 0xFF) << blue_shift;
+}
+
+// Primitivas: preenchimento e cópia de trechos de linha
+
+static void fill_span(uint32_t *dst, int n, uint32_t color) {
+#ifdef __SSE2__
+    __m128i v = _mm_set1_epi32((int)color);
+    for (; n >= 8; n -= 8, dst += 8) {
+        _mm_storeu_si128((__m128i *)dst, v);
+        _mm_storeu_si128((__m128i *)(dst + 4), v);
+    }
+    for (; n >= 4; n -= 4, dst += 4) _mm_storeu_si128((__m128i *)dst, v);
+#endif
+    while (n-- > 0) *dst++ = color;
+}
+
+static void copy_span(uint32_t *dst, const uint32_t *src, int n) {
+#ifdef __SSE2__
+    for (; n >= 8; n -= 8, dst += 8, src += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i *)src);
+        __m128i b = _mm_loadu_si128((const __m128i *)(src + 4));
+        _mm_storeu_si128((__m128i *)dst, a);
+        _mm_storeu_si128((__m128i *)(dst + 4), b);
+    }
+    for (; n >= 4; n -= 4, dst += 4, src += 4) {
+        _mm_storeu_si128((__m128i *)dst, _mm_loadu_si128((const __m128i *)src));
+    }
+#endif
+    while (n-- > 0) *dst++ = *src++;
+}
+
+static Rect intersect(Rect a, Rect b) {
+    int x0 = a.x > b.x ? a.x : b.x;
+    int y0 = a.y > b.y ? a.y : b.y;
+    int x1 = (a.x + a.w) < (b.x + b.w) ? (a.x + a.w) : (b.x + b.w);
+    int y1 = (a.y + a.h) < (b.y + b.h) ? (a.y + a.h) : (b.y + b.h);
+    Rect r = { x0, y0, x1 - x0, y1 - y0 };
+    if (r.w < 0) r.w = 0;
+    if (r.h < 0) r.h = 0;
+    return r;
+}
+
+static void fill_rect(uint32_t *buf, int buf_stride, Rect r, Rect clip, uint32_t color) {
+    r = intersect(r, clip);
+    for (int y = r.y; y < r.y + r.h; y++) fill_span(buf + y * buf_stride + r.x, r.w, color);
+}
+
+static void blit(uint32_t *dst, int dst_stride, const uint32_t *src, int src_stride, Rect r) {
+    for (int y = r.y; y < r.y + r.h; y++) {
+        copy_span(dst + y * dst_stride + r.x, src + y * src_stride + r.x, r.w);
+    }
+}
+
+// Geometria e fundo
+
+static void layout(int lanes) {
+    layout_lanes = lanes;
+    lane_w = width / (lanes + 2);
+    if (lane_w > height / 5) lane_w = height / 5;
+    track_x = (width - lane_w * lanes) / 2;
+    hud_h = height / 12;
+    track_top = hud_h;
+    strike_y = height - height / 10;
+    note_h = lane_w / 4 > 4 ? lane_w / 4 : 4;
+}
+
+static void draw_background(void) {
+    Rect all = { 0, 0, width, height };
+    fill_rect(bg, width, all, all, pack(0x000000));
+
+    for (int lane = 0; lane < layout_lanes; lane++) {
+        Rect stripe = { track_x + lane * lane_w, track_top, lane_w, height - track_top };
+        fill_rect(bg, width, stripe, all, pack(lane & 1 ? 0x181818 : 0x202020));
+
+        // Linha de batida na cor da pista, escurecida
+        uint32_t rgb = (lane_rgb[lane] >> 1) & 0x7F7F7F;
+        Rect strike = { stripe.x, strike_y - 2, lane_w, 4 };
+        fill_rect(bg, width, strike, all, pack(rgb));
+    }
+}
+
+static Rect note_rect(const HwNote *n) {
+    int center = track_top + (int)(n->pos * (strike_y - track_top));
+    Rect r = { track_x + n->lane * lane_w + lane_w / 8, center - note_h / 2,
+               lane_w - lane_w / 4, note_h };
+    return r;
+}
+
+static Rect hud_rect(void) {
+    Rect r = { 0, 0, width, hud_h };
+    return r;
+}
+
+// Número em dígitos 3x5 ampliados px vezes; retorna o x depois dele
+static int draw_number(int x, int px, int value, uint32_t rgb, Rect clip) {
+    char text[16];
+    int len = snprintf(text, sizeof(text), "%d", value);
+
+    for (int i = 0; i < len; i++) {
+        uint16_t glyph = digits[text[i] - '0'];
+        for (int row = 0; row < 5; row++) {
+            for (int col = 0; col < 3; col++) {
+                if (glyph & (1 << (14 - row * 3 - col))) {
+                    Rect dot = { x + col * px, px + row * px, px, px };
+                    fill_rect(back, width, dot, clip, pack(rgb));
+                }
+            }
+        }
+        x += 4 * px;
+    }
+    return x;
+}
+
+// Placar, o do adversário em cinza ao lado, e um quadrado por erro
+// permitido
+static void draw_hud(const HwScene *sc, Rect clip) {
+    int px = hud_h / 7 > 1 ? hud_h / 7 : 1;
+    int x = draw_number(track_x, px, sc->score, 0xFFFFFF, clip);
+    if (sc->peer_score >= 0) draw_number(x + 4 * px, px, sc->peer_score, 0x808080, clip);
+
+    // Energia: barra na base do placar, amarela com o bônus ligado
+    if (sc->power >= 0) {
+        int span = width - 2 * track_x;
+        Rect bar = { track_x, hud_h - px, span * sc->power / 100, px };
+        fill_rect(back, width, bar, clip, pack(sc->power_active ? 0xFFD000 : 0x00A0E0));
+    }
+
+    for (int i = 0; i < sc->max_misses; i++) {
+        Rect box = { width - (i + 1) * 4 * px - px, px, 3 * px, 3 * px };
+        fill_rect(back, width, box, clip, pack(i < sc->misses ? 0xE00000 : 0x303030));
+    }
+}
+
+static bool same_rect(Rect a, Rect b) {
+    return a.x == b.x && a.y == b.y && a.w == b.w && a.h == b.h;
+}
+
+static void add_dirty(Rect *dirty, int *count, Rect r) {
+    Rect screen = { 0, 0, width, height };
+    r = intersect(r, screen);
+    if (r.w == 0 || r.h == 0) return;
+
+    if (*count < FB_MAX_DIRTY) {
+        dirty[(*count)++] = r;
+        return;
+    }
+    // Lista cheia: junta com o último retângulo
+    Rect *u = &dirty[FB_MAX_DIRTY - 1];
+    int x1 = (u->x + u->w) > (r.x + r.w) ? (u->x + u->w) : (r.x + r.w);
+    int y1 = (u->y + u->h) > (r.y + r.h) ? (u->y + u->h) : (r.y + r.h);
+    u->x = u->x < r.x ? u->x : r.x;
+    u->y = u->y < r.y ? u->y : r.y;
+    u->w = x1 - u->x;
+    u->h = y1 - u->y;
+}
+
+// Recompõe e copia para a tela só os retângulos que mudaram. Retorna os
+// bytes copiados para a tela
+static int fb_flush(const HwScene *sc) {
+    if (sc->lanes != layout_lanes) {
+        layout(sc->lanes);
+        full_redraw = true;
+    }
+
+    Rect cur[HW_MAX_NOTES];
+    for (int i = 0; i < sc->note_count; i++) cur[i] = note_rect(&sc->notes[i]);
+
+    Rect dirty[FB_MAX_DIRTY];
+    int nd = 0;
+
+    if (full_redraw) {
+        draw_background();
+        Rect all = { 0, 0, width, height };
+        dirty[nd++] = all;
+        full_redraw = false;
+    } else {
+        // Nota parada no mesmo lugar e na mesma pista não suja nada
+        for (int i = 0; i < prev_count; i++) {
+            bool kept = false;
+            for (int j = 0; j < sc->note_count && !kept; j++) {
+                kept = same_rect(prev_rects[i], cur[j]) && prev_lanes[i] == sc->notes[j].lane;
+            }
+            if (!kept) add_dirty(dirty, &nd, prev_rects[i]);
+        }
+        for (int j = 0; j < sc->note_count; j++) {
+            bool kept = false;
+            for (int i = 0; i < prev_count && !kept; i++) {
+                kept = same_rect(prev_rects[i], cur[j]) && prev_lanes[i] == sc->notes[j].lane;
+            }
+            if (!kept) add_dirty(dirty, &nd, cur[j]);
+        }
+        if (sc->score != shown_score || sc->misses != shown_misses || sc->peer_score != shown_peer ||
+            sc->power != shown_power || sc->power_active != shown_active) {
+            add_dirty(dirty, &nd, hud_rect());
+        }
+    }
+
+    int bytes = 0;
+    for (int d = 0; d < nd; d++) {
+        Rect clip = dirty[d];
+        blit(back, width, bg, width, clip);
+        for (int i = 0; i < sc->note_count; i++) {
+            fill_rect(back, width, cur[i], clip, pack(lane_rgb[sc->notes[i].lane]));
+        }
+        if (intersect(clip, hud_rect()).h > 0) draw_hud(sc, clip);
+        blit(front, stride, back, width, clip);
+        bytes += clip.w * clip.h * 4;
+    }
+
+    memcpy(prev_rects, cur, sc->note_count * sizeof(Rect));
+    for (int i = 0; i < sc->note_count; i++) prev_lanes[i] = sc->notes[i].lane;
+    prev_count = sc->note_count;
+    shown_score = sc->score;
+    shown_misses = sc->misses;
+    shown_peer = sc->peer_score;
+    shown_power = sc->power;
+    shown_active = sc->power_active;
+    return bytes;
+}
+
+static void fb_invalidate(void) {
+    full_redraw = true;
+}
+
+int fb_dump_ppm(const char *path) {
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        lg_postf(LG_ERROR, errno, "Falha ao gravar PPM %s", path);
+        return -1;
+    }
+
+    unsigned char *row = malloc(width * 3);
+    if (row == NULL) {
+        lg_perror("Falha ao alocar linha do PPM");
+        fclose(f);
+        return -1;
+    }
+    fprintf(f, "P6\n%d %d\n255\n", width, height);
+    for (int y = 0; y < height; y++) {
+        const uint32_t *src = front + y * stride;
+        for (int x = 0; x < width; x++) {
+            row[x * 3] = src[x] >> red_shift;
+            row[x * 3 + 1] = src[x] >> green_shift;
+            row[x * 3 + 2] = src[x] >> blue_shift;
+        }
+        fwrite(row, 1, width * 3, f);
+    }
+    free(row);
+    fclose(f);
+    return 0;
+}
+
+static void fb_snapshot(void) {
+    if (ppm_path[0]) fb_dump_ppm(ppm_path);
+}
+
+static void fb_close(void) {
+    fb_snapshot();
+    if (fb_map != MAP_FAILED) munmap(fb_map, fb_map_len);
+    else free(front);
+    if (fb_fd >= 0) close(fb_fd);
+    free(bg);
+    free(back);
+    fb_map = MAP_FAILED;
+    fb_fd = -1;
+    front = bg = back = NULL;
+    ppm_path[0] = '\0';
+    layout_lanes = -1;
+    prev_count = 0;
+}
+
+static const HwBackend fb_backend = {
+    .flush = fb_flush,
+    .invalidate = fb_invalidate,
+    .snapshot = fb_snapshot,
+    .close = fb_close,
+};
+
+static const HwBackend *alloc_buffers(void) {
+    bg = malloc((size_t)width * height * sizeof(uint32_t));
+    back = malloc((size_t)width * height * sizeof(uint32_t));
+    if (bg == NULL || back == NULL) {
+        lg_perror("Falha ao alocar buffers de video");
+        fb_close();
+        return NULL;
+    }
+    full_redraw = true;
+    shown_score = shown_misses = -1;
+    shown_peer = shown_power = -2;
+    return &fb_backend;
+}
+
+const HwBackend *fb_open(const char *device) {
+    fb_fd = open(device, O_RDWR);
+    if (fb_fd < 0) {
+        lg_postf(LG_ERROR, errno, "Falha ao abrir framebuffer %s", device);
+        return NULL;
+    }
+
+    struct fb_var_screeninfo var;
+    struct fb_fix_screeninfo fix;
+    if (ioctl(fb_fd, FBIOGET_VSCREENINFO, &var) < 0 ||
+        ioctl(fb_fd, FBIOGET_FSCREENINFO, &fix) < 0) {
+        lg_postf(LG_ERROR, errno, "Falha ao consultar framebuffer %s", device);
+        close(fb_fd);
+        fb_fd = -1;
+        return NULL;
+    }
+    if (var.bits_per_pixel != 32) {
+        lg_error("Framebuffer com %u bpp nao suportado (so 32)", var.bits_per_pixel);
+        close(fb_fd);
+        fb_fd = -1;
+        return NULL;
+    }
+
+    fb_map_len = fix.smem_len;
+    fb_map = mmap(NULL, fb_map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fb_fd, 0);
+    if (fb_map == MAP_FAILED) {
+        lg_postf(LG_ERROR, errno, "Falha ao mapear framebuffer %s", device);
+        close(fb_fd);
+        fb_fd = -1;
+        return NULL;
+    }
+
+    width = var.xres;
+    height = var.yres;
+    stride = fix.line_length / 4;
+    red_shift = var.red.offset;
+    green_shift = var.green.offset;
+    blue_shift = var.blue.offset;
+    front = (uint32_t *)fb_map + var.yoffset * stride + var.xoffset;
+    ppm_path[0] = '\0';
+    return alloc_buffers();
+}
+
+// Imagem em memória; snapshots (e o fechamento) gravam em ppm_path
+const HwBackend *fb_open_image(int w, int h, const char *path) {
+    // O tamanho vem de GH_RENDER: os bytes da imagem (w*h*4, retornados
+    // pelo flush como int) precisam caber num int
+    if (w <= 0 || h <= 0 || w > INT_MAX / 4 / h) {
+        lg_error("Tamanho de imagem invalido: %dx%d", w, h);
+        return NULL;
+    }
+    width = w;
+    height = h;
+    stride = w;
+    red_shift = 16;
+    green_shift = 8;
+    blue_shift = 0;
+    front = calloc((size_t)w * h, sizeof(uint32_t));
+    if (front == NULL) {
+        lg_perror("Falha ao alocar imagem");
+        return NULL;
+    }
+    strncpy(ppm_path, path, sizeof(ppm_path) - 1);
+    return alloc_buffers();
+}
@@ -0,0 +1,20 @@
+#ifndef FB_RENDER_H
+#define FB_RENDER_H
+
+#include "highway.h"
+
+// Backend de pista por rasterização: desenha em /dev/fb0 (32 bpp) ou numa
+// imagem em memória gravada como PPM, para testes sem tela. Só os
+// retângulos que mudaram (notas antigas e novas, placar) são recompostos a
+// partir do fundo estático e copiados para a tela.
+
+#define FB_DEFAULT_DEVICE "/dev/fb0"
+#define FB_IMAGE_WIDTH 640
+#define FB_IMAGE_HEIGHT 480
+#define FB_MAX_DIRTY 64
+
+const HwBackend *fb_open(const char *device);
+const HwBackend *fb_open_image(int width, int height, const char *ppm_path);
+int fb_dump_ppm(const char *path);
+
+#endif
@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "fb_render.h"
+
+// Teste do rasterizador sem tela: desenha uma cena na imagem em memória,
+// grava o PPM e confere os pixels lidos de volta. Sai com status 1 na
+// primeira falha.
+
+#define W 160
+#define H 120
+#define LANES 4
+#define PPM "/tmp/fb_render_test.ppm"
+
+static int failures = 0;
+
+#define CHECK(cond, msg) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FALHOU: %s (%s:%d)\n", msg, __FILE__, __LINE__); \
+        failures++; \
+    } \
+} while (0)
+
+static unsigned char image[W * H * 3];
+
+// Geometria de layout() em fb_render.c para W x H e LANES pistas
+static int lane_w, track_x, track_top, strike_y;
+
+static void geometry(void) {
+    lane_w = W / (LANES + 2);
+    if (lane_w > H / 5) lane_w = H / 5;
+    track_x = (W - lane_w * LANES) / 2;
+    track_top = H / 12;
+    strike_y = H - H / 10;
+}
+
+static int load_ppm(void) {
+    FILE *f = fopen(PPM, "rb");
+    if (f == NULL) return -1;
+    int w, h, max;
+    int ok = fscanf(f, "P6 %d %d %d", &w, &h, &max) == 3 && fgetc(f) == '\n' &&
+             w == W && h == H && max == 255 && fread(image, 1, sizeof(image), f) == sizeof(image);
+    fclose(f);
+    return ok ? 0 : -1;
+}
+
+static uint32_t pixel(int x, int y) {
+    const unsigned char *p = image + (y * W + x) * 3;
+    return (uint32_t)p[0] << 16 | p[1] << 8 | p[2];
+}
+
+// Centro da nota na pista lane e posição pos
+static int note_x(int lane) {
+    return track_x + lane * lane_w + lane_w / 2;
+}
+
+static int note_y(float pos) {
+    return track_top + (int)(pos * (strike_y - track_top));
+}
+
+static HwScene scene(float pos) {
+    HwScene sc = { .lanes = LANES, .peer_score = -1, .power = -1 };
+    sc.notes[0] = (HwNote){ .lane = 0, .pos = pos };
+    sc.notes[1] = (HwNote){ .lane = 3, .pos = 0.25f };
+    sc.note_count = 2;
+    return sc;
+}
+
+int main(void) {
+    geometry();
+    // Tamanho inválido ou grande demais é recusado antes de alocar
+    CHECK(fb_open_image(0, H, PPM) == NULL, "largura zero aceita");
+    CHECK(fb_open_image(W, -1, PPM) == NULL, "altura negativa aceita");
+    CHECK(fb_open_image(100000, 100000, PPM) == NULL, "tamanho que estoura aceito");
+
+    const HwBackend *fb = fb_open_image(W, H, PPM);
+    if (fb == NULL) {
+        fprintf(stderr, "FALHOU: fb_open_image\n");
+        return 1;
+    }
+
+    // Primeiro quadro redesenha a tela inteira
+    HwScene sc = scene(0.5f);
+    CHECK(fb->flush(&sc) == W * H * 4, "primeiro quadro nao copiou a tela inteira");
+    CHECK(fb_dump_ppm(PPM) == 0 && load_ppm() == 0, "PPM nao gravado ou invalido");
+    CHECK(pixel(0, H - 1) == 0x000000, "fundo fora da pista");
+    CHECK(pixel(note_x(1), H - 1) == 0x181818, "faixa da pista 1");
+    CHECK(pixel(note_x(1), strike_y) == 0x700000, "linha de batida da pista 1");
+    CHECK(pixel(note_x(0), note_y(0.5f)) == 0x00C000, "nota da pista 0");
+    CHECK(pixel(note_x(3), note_y(0.25f)) == 0x2040FF, "nota da pista 3");
+
+    // Quadro seguinte: só a nota que andou é recomposta
+    sc = scene(0.75f);
+    int bytes = fb->flush(&sc);
+    CHECK(bytes > 0 && bytes < W * H * 4 / 10, "nota andando redesenhou demais");
+    CHECK(fb_dump_ppm(PPM) == 0 && load_ppm() == 0, "segundo PPM");
+    CHECK(pixel(note_x(0), note_y(0.5f)) == 0x202020, "rastro da nota antiga");
+    CHECK(pixel(note_x(0), note_y(0.75f)) == 0x00C000, "nota na posicao nova");
+    CHECK(pixel(note_x(3), note_y(0.25f)) == 0x2040FF, "nota parada sumiu");
+
+    // Nada mudou: nada é copiado
+    CHECK(fb->flush(&sc) == 0, "quadro igual copiou pixels");
+
+    fb->close();
+    remove(PPM);
+    if (failures == 0) printf("fb_render: ok\n");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,405 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <string.h>
+#include <stdbool.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "frame_io.h"
+#include "logger.h"
+
+unsigned long fio_syscalls = 0;
+unsigned long fio_frames = 0;
+
+typedef struct {
+    int fd;
+    int record_size;
+    unsigned char buf[FIO_IN_BUF];
+    int len;
+    // Leitura pendente no anel (io_uring). O kernel escreve em landing,
+    // não em buf, porque fio_read desloca buf enquanto a leitura espera
+    unsigned char landing[FIO_IN_BUF];
+    bool armed;
+    bool closed;
+    int saved_flags;          // Flags do fd antes do registro, devolvidas no fio_close
+} FioInput;
+
+// Dois buffers de saída: um é preenchido enquanto o outro pode estar
+// sendo escrito pelo kernel
+typedef struct {
+    char data[FIO_OUT_SIZE];
+    int len;
+    int sent;
+    bool in_flight;
+} FioOut;
+
+static FioBackend backend = FIO_READ;
+static int out_fd = STDOUT_FILENO;
+static FioInput inputs[FIO_MAX_INPUTS];
+static int input_count = 0;
+static FioOut outs[2];
+static int cur_out = 0;
+
+// Estado do io_uring (sem liburing, direto pelas syscalls)
+static int ring_fd = -1;
+static unsigned *sq_tail, *sq_mask, *sq_array;
+static unsigned *cq_head, *cq_tail, *cq_mask;
+static struct io_uring_sqe *sqes;
+static struct io_uring_cqe *cqes;
+static void *sq_ptr = MAP_FAILED, *cq_ptr = MAP_FAILED;
+static size_t sq_size, cq_size, sqes_size;
+static unsigned sq_local_tail, sq_submitted;
+static int writes_in_flight = 0;
+
+#define UD_WRITE 0x100
+#define UD_READ 0x200
+
+FioBackend fio_backend_from_env(void) {
+    const char *io = getenv("GH_IO");
+    return (io != NULL && strcmp(io, "uring") == 0) ? FIO_URING : FIO_READ;
+}
+
+static int uring_setup(void) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+
+    ring_fd = syscall(__NR_io_uring_setup, FIO_RING_SIZE, &p);
+    if (ring_fd < 0) return -1;
+
+    // Sem IORING_FEAT_EXT_ARG não há como esperar com timeout sem um SQE
+    // extra, então nem vale a pena
+    if (!(p.features & IORING_FEAT_EXT_ARG)) {
+        close(ring_fd);
+        ring_fd = -1;
+        errno = ENOSYS;
+        return -1;
+    }
+
+    sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (cq_size > sq_size) sq_size = cq_size;
+        cq_size = sq_size;
+    }
+
+    sq_ptr = mmap(NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                  ring_fd, IORING_OFF_SQ_RING);
+    if (sq_ptr == MAP_FAILED) return -1;
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        cq_ptr = sq_ptr;
+    } else {
+        cq_ptr = mmap(NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring_fd, IORING_OFF_CQ_RING);
+        if (cq_ptr == MAP_FAILED) return -1;
+    }
+
+    sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    sqes = mmap(NULL, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                ring_fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) return -1;
+
+    sq_tail = (unsigned *)((char *)sq_ptr + p.sq_off.tail);
+    sq_mask = (unsigned *)((char *)sq_ptr + p.sq_off.ring_mask);
+    sq_array = (unsigned *)((char *)sq_ptr + p.sq_off.array);
+    cq_head = (unsigned *)((char *)cq_ptr + p.cq_off.head);
+    cq_tail = (unsigned *)((char *)cq_ptr + p.cq_off.tail);
+    cq_mask = (unsigned *)((char *)cq_ptr + p.cq_off.ring_mask);
+    cqes = (struct io_uring_cqe *)((char *)cq_ptr + p.cq_off.cqes);
+
+    sq_local_tail = sq_submitted = *sq_tail;
+    return 0;
+}
+
+static void uring_teardown(void) {
+    if (sqes != NULL && sqes != MAP_FAILED) munmap(sqes, sqes_size);
+    if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr) munmap(cq_ptr, cq_size);
+    if (sq_ptr != MAP_FAILED) munmap(sq_ptr, sq_size);
+    if (ring_fd >= 0) close(ring_fd);
+    sqes = NULL;
+    sq_ptr = cq_ptr = MAP_FAILED;
+    ring_fd = -1;
+}
+
+// Inicializa; se o io_uring não estiver disponível, volta para read/write
+FioBackend fio_init(FioBackend wanted, int fd) {
+    out_fd = fd;
+    input_count = 0;
+    cur_out = 0;
+    memset(outs, 0, sizeof(outs));
+    backend = FIO_READ;
+
+    if (wanted == FIO_URING) {
+        if (uring_setup() == 0) {
+            backend = FIO_URING;
+        } else {
+            lg_post(LG_WARN, errno, "io_uring indisponivel, usando read/write");
+            uring_teardown();
+        }
+    }
+    return backend;
+}
+
+// Registra um fd de entrada cujos registros têm record_size bytes
+int fio_add_input(int fd, int record_size) {
+    if (input_count >= FIO_MAX_INPUTS || fd < 0) return -1;
+
+    FioInput *in = &inputs[input_count];
+    memset(in, 0, sizeof(*in));
+    in->fd = fd;
+    in->record_size = record_size;
+    in->saved_flags = fcntl(fd, F_GETFL);
+
+    // O anel já espera pelo dado; O_NONBLOCK só faria a leitura voltar
+    // com -EAGAIN. O fd (às vezes o stdin) volta como era no fio_close
+    if (backend == FIO_URING && in->saved_flags >= 0) {
+        fcntl(fd, F_SETFL, in->saved_flags & ~O_NONBLOCK);
+    }
+    return input_count++;
+}
+
+void fio_printf(const char *fmt, ...) {
+    FioOut *out = &outs[cur_out];
+    int room = FIO_OUT_SIZE - out->len;
+    if (room <= 1) return;
+
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(out->data + out->len, room, fmt, ap);
+    va_end(ap);
+
+    if (n > 0) out->len += n < room ? n : room - 1;
+}
+
+// Retira um registro completo da entrada. Retorna 1 se havia um
+int fio_read(int input, void *record) {
+    FioInput *in = &inputs[input];
+    if (in->len < in->record_size) return 0;
+
+    memcpy(record, in->buf, in->record_size);
+    in->len -= in->record_size;
+    memmove(in->buf, in->buf + in->record_size, in->len);
+    return 1;
+}
+
+// Backend read/write
+
+static int frame_read(int timeout_ms) {
+    FioOut *out = &outs[cur_out];
+    while (out->sent < out->len) {
+        ssize_t n = write(out_fd, out->data + out->sent, out->len - out->sent);
+        fio_syscalls++;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        out->sent += n;
+    }
+    out->len = out->sent = 0;
+
+    struct pollfd pfds[FIO_MAX_INPUTS];
+    int nfds = 0;
+    for (int i = 0; i < input_count; i++) {
+        pfds[i].fd = inputs[i].closed ? -1 : inputs[i].fd;
+        pfds[i].events = POLLIN;
+        pfds[i].revents = 0;
+        nfds++;
+    }
+    if (nfds == 0 && timeout_ms == 0) return 0;
+
+    int r = poll(pfds, nfds, timeout_ms);
+    fio_syscalls++;
+    if (r <= 0) return 0;
+
+    int ready = 0;
+    for (int i = 0; i < nfds; i++) {
+        FioInput *in = &inputs[i];
+        if (!(pfds[i].revents & (POLLIN | POLLHUP))) continue;
+        if (in->len >= FIO_IN_BUF) continue;
+
+        ssize_t n = read(in->fd, in->buf + in->len, FIO_IN_BUF - in->len);
+        fio_syscalls++;
+        if (n > 0) {
+            in->len += n;
+            ready++;
+        } else if (n == 0) {
+            in->closed = true;
+        }
+    }
+    return ready;
+}
+
+// Backend io_uring
+
+static struct io_uring_sqe *get_sqe(void) {
+    unsigned idx = sq_local_tail & *sq_mask;
+    struct io_uring_sqe *sqe = &sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sq_array[idx] = idx;
+    sq_local_tail++;
+    return sqe;
+}
+
+static void queue_write(int buf) {
+    FioOut *out = &outs[buf];
+    struct io_uring_sqe *sqe = get_sqe();
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = out_fd;
+    sqe->addr = (unsigned long)(out->data + out->sent);
+    sqe->len = out->len - out->sent;
+    sqe->off = (__u64)-1;
+    sqe->user_data = UD_WRITE | buf;
+    out->in_flight = true;
+    writes_in_flight++;
+}
+
+static void queue_read(int i) {
+    FioInput *in = &inputs[i];
+    struct io_uring_sqe *sqe = get_sqe();
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = in->fd;
+    sqe->addr = (unsigned long)in->landing;
+    sqe->len = FIO_IN_BUF - in->len; // O espaço em buf só cresce até a conclusão
+    sqe->off = (__u64)-1;
+    sqe->user_data = UD_READ | i;
+    in->armed = true;
+}
+
+// Processa as conclusões; só memória compartilhada, sem syscall
+static int reap(void) {
+    int ready = 0;
+    unsigned head = *cq_head;
+    unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+
+    while (head != tail) {
+        struct io_uring_cqe *cqe = &cqes[head & *cq_mask];
+        int idx = cqe->user_data & 0xff;
+
+        if (cqe->user_data & UD_WRITE) {
+            FioOut *out = &outs[idx];
+            writes_in_flight--;
+            out->in_flight = false;
+            if (cqe->res > 0 && out->sent + cqe->res < out->len) {
+                // Escrita parcial: o resto vai no próximo envio
+                out->sent += cqe->res;
+                queue_write(idx);
+            } else {
+                out->len = out->sent = 0;
+            }
+        } else if (cqe->user_data & UD_READ) {
+            FioInput *in = &inputs[idx];
+            in->armed = false;
+            if (cqe->res > 0) {
+                memcpy(in->buf + in->len, in->landing, cqe->res);
+                in->len += cqe->res;
+                ready++;
+            } else if (cqe->res == 0) {
+                in->closed = true;
+            }
+        }
+        head++;
+    }
+    __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+    return ready;
+}
+
+// Publica os SQEs novos no anel e diz quantos faltam submeter
+static unsigned publish_sqes(void) {
+    __atomic_store_n(sq_tail, sq_local_tail, __ATOMIC_RELEASE);
+    unsigned to_submit = sq_local_tail - sq_submitted;
+    sq_submitted = sq_local_tail;
+    return to_submit;
+}
+
+static int uring_enter(unsigned to_submit, unsigned min_complete, int timeout_ms) {
+    struct __kernel_timespec ts = { timeout_ms / 1000, (timeout_ms % 1000) * 1000000L };
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    unsigned flags = 0;
+
+    if (min_complete > 0) {
+        flags |= IORING_ENTER_GETEVENTS;
+        if (timeout_ms >= 0) {
+            flags |= IORING_ENTER_EXT_ARG;
+            arg.ts = (unsigned long)&ts;
+        }
+    }
+
+    fio_syscalls++;
+    return syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags,
+                   (flags & IORING_ENTER_EXT_ARG) ? (void *)&arg : NULL,
+                   sizeof(arg));
+}
+
+// Espera o buffer atual (ou todos) sair do kernel, reenviando restos de
+// escritas parciais
+static void wait_writes(bool current_only) {
+    while (current_only ? outs[cur_out].in_flight : writes_in_flight > 0) {
+        if (uring_enter(publish_sqes(), 1, -1) < 0 && errno != EINTR) break;
+        reap();
+    }
+}
+
+static int frame_uring(int timeout_ms) {
+    int ready = reap();
+
+    FioOut *out = &outs[cur_out];
+    if (out->len > 0) {
+        queue_write(cur_out);
+        cur_out ^= 1;
+    }
+
+    for (int i = 0; i < input_count; i++) {
+        FioInput *in = &inputs[i];
+        if (!in->armed && !in->closed && in->len < FIO_IN_BUF) queue_read(i);
+    }
+
+    unsigned to_submit = publish_sqes();
+
+    // Espera todas as escritas em voo mais uma leitura. Se já há dado, se
+    // nenhuma leitura está armada ou se não é para esperar, só submete:
+    // pedir uma conclusão que não vem faria o enter esgotar o prazo (ETIME)
+    bool reading = false;
+    for (int i = 0; i < input_count; i++) reading |= inputs[i].armed;
+    unsigned min_complete = (ready || !reading || timeout_ms == 0) ? 0 : writes_in_flight + 1;
+    if (to_submit > 0 || min_complete > 0) {
+        uring_enter(to_submit, min_complete, timeout_ms);
+    }
+    ready += reap();
+
+    // O próximo buffer ainda está com o kernel (terminal lento): espera
+    wait_writes(true);
+    return ready;
+}
+
+// Envia a saída acumulada e espera entradas por até timeout_ms.
+// Retorna o número de entradas que receberam dados
+int fio_frame(int timeout_ms) {
+    fio_frames++;
+    if (backend == FIO_URING) return frame_uring(timeout_ms);
+    return frame_read(timeout_ms);
+}
+
+void fio_close(void) {
+    if (backend == FIO_URING) {
+        // Garante que a última tela chegou ao terminal
+        reap();
+        if (outs[cur_out].len > 0) queue_write(cur_out);
+        wait_writes(false);
+        uring_teardown();
+    } else {
+        frame_read(0);
+    }
+    for (int i = 0; i < input_count; i++) {
+        if (inputs[i].saved_flags >= 0) fcntl(inputs[i].fd, F_SETFL, inputs[i].saved_flags);
+    }
+    input_count = 0;
+    backend = FIO_READ;
+}
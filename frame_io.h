@@ -0,0 +1,32 @@
+#ifndef FRAME_IO_H
+#define FRAME_IO_H
+
+// E/S por quadro: a saída do terminal é acumulada num buffer e enviada de
+// uma vez, e as leituras de joystick/teclado ficam agrupadas numa única
+// espera. Dois backends: poll()+read()/write() e io_uring, onde leituras
+// ficam armadas no anel e o quadro inteiro custa no máximo um
+// io_uring_enter.
+
+#define FIO_OUT_SIZE 16384    // Bytes de saída por quadro
+#define FIO_MAX_INPUTS 4
+#define FIO_IN_BUF 256        // Bytes acumulados por entrada
+#define FIO_RING_SIZE 16
+
+typedef enum {
+    FIO_READ,                 // poll() + read()/write()
+    FIO_URING
+} FioBackend;
+
+FioBackend fio_init(FioBackend backend, int out_fd);
+FioBackend fio_backend_from_env(void);
+int fio_add_input(int fd, int record_size);
+void fio_printf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+int fio_frame(int timeout_ms);
+int fio_read(int input, void *record);
+void fio_close(void);
+
+// Contadores para comparar os backends
+extern unsigned long fio_syscalls;
+extern unsigned long fio_frames;
+
+#endif
@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <linux/joystick.h>
+
+#include "frame_io.h"
+
+// Compara syscalls por quadro entre os backends do frame_io. Pipes fazem
+// o papel do joystick e do teclado e a saída vai para /dev/null.
+
+#define FRAMES 500
+#define LINES_PER_FRAME 14
+
+static double now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void run(FioBackend wanted) {
+    int joy[2], kbd[2];
+    if (pipe(joy) < 0 || pipe(kbd) < 0) {
+        perror("pipe");
+        exit(1);
+    }
+    int out = open("/dev/null", O_WRONLY);
+
+    FioBackend got = fio_init(wanted, out);
+    int joy_in = fio_add_input(joy[0], sizeof(struct js_event));
+    int kbd_in = fio_add_input(kbd[0], 1);
+
+    fio_syscalls = 0;
+    fio_frames = 0;
+    int events = 0;
+    double start = now_us();
+
+    for (int frame = 0; frame < FRAMES; frame++) {
+        // Um botão a cada 4 quadros e uma tecla a cada 10
+        if (frame % 4 == 0) {
+            struct js_event e = { frame, 1, JS_EVENT_BUTTON, frame % 4 };
+            write(joy[1], &e, sizeof(e));
+        }
+        if (frame % 10 == 0) write(kbd[1], "1", 1);
+
+        for (int y = 0; y < LINES_PER_FRAME; y++) {
+            fio_printf("\033[%d;1H. . 1 . . . . .\n", y + 1);
+        }
+        fio_printf("Score: %d\n", frame * 10);
+
+        fio_frame(1);
+
+        struct js_event e;
+        char c;
+        while (fio_read(joy_in, &e)) events++;
+        while (fio_read(kbd_in, &c)) events++;
+    }
+
+    double elapsed = now_us() - start;
+    printf("%-10s %6.2f syscalls/quadro  %7.1f us/quadro  %d eventos\n",
+           got == FIO_URING ? "io_uring" : "read/poll",
+           (double)fio_syscalls / fio_frames, elapsed / FRAMES, events);
+
+    fio_close();
+    close(out);
+    close(joy[0]); close(joy[1]);
+    close(kbd[0]); close(kbd[1]);
+}
+
+int main() {
+    run(FIO_READ);
+    run(FIO_URING);
+    return 0;
+}
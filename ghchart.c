@@ -0,0 +1,240 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "chart.h"
+#include "onset.h"
+
+// Gera partituras (.chart) a partir de arquivos WAV. Cada arquivo é
+// analisado por uma thread; por padrão uma thread por CPU.
+//
+//   ghchart [-j threads] [-l pistas] [-o diretorio] musica.wav...
+
+#define DEFAULT_LANES 4
+#define MAX_LANES 8           // Mesmo limite de pistas do jogo
+#define MAX_THREADS 64
+
+typedef struct {
+    const char *name;
+    float beats;              // Distância mínima entre notas, em batidas
+    float min_gap_s;          // Piso da distância, para andamentos rápidos
+    int max_lanes;
+} Level;
+
+// Mesma ordem das músicas aleatórias do jogo
+static const Level levels[] = {
+    { "facil", 1.0f, 0.30f, 3 },
+    { "medio", 0.5f, 0.15f, MAX_LANES },
+    { "dificil", 0.25f, 0.08f, MAX_LANES },
+};
+#define LEVEL_COUNT (int)(sizeof(levels) / sizeof(levels[0]))
+
+static char **inputs;
+static int input_count;
+static int next_input = 0;
+static int lanes = DEFAULT_LANES;
+static const char *out_dir = NULL;
+static double audio_seconds = 0;
+static int failures = 0;
+static pthread_mutex_t totals_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int by_float(const void *a, const void *b) {
+    float x = *(const float *)a, y = *(const float *)b;
+    return (x > y) - (x < y);
+}
+
+typedef struct {
+    float strength;
+    int index;
+} Ranked;
+
+static int by_strength(const void *a, const void *b) {
+    float x = ((const Ranked *)a)->strength, y = ((const Ranked *)b)->strength;
+    return (x < y) - (x > y);
+}
+
+// Escolhe os ataques mais fortes respeitando a distância mínima do nível
+// e distribui as pistas pelo centroide espectral: sons mais agudos vão
+// mais para a direita, em faixas com a mesma quantidade de notas
+static int build_level(const OnsetResult *res, const Level *lv, ChartLevel *out) {
+    int n = res->count;
+    int nl = lv->max_lanes < lanes ? lv->max_lanes : lanes;
+    float beat = res->bpm > 0 ? 60 / res->bpm : 0.5f;
+    float gap = lv->beats * beat;
+    if (gap < lv->min_gap_s) gap = lv->min_gap_s;
+
+    Ranked *order = malloc((n ? n : 1) * sizeof(Ranked));
+    bool *keep = calloc(n ? n : 1, sizeof(bool));
+    float *sorted = malloc((n ? n : 1) * sizeof(float));
+    float bounds[MAX_LANES];
+    memset(out, 0, sizeof(*out));
+    strncpy(out->name, lv->name, CHART_LEVEL_LEN - 1);
+    out->notes = malloc((n ? n : 1) * sizeof(ChartNote));
+    if (!order || !keep || !sorted || !out->notes) {
+        perror("Falha ao alocar nivel");
+        free(order);
+        free(keep);
+        free(sorted);
+        return -1;
+    }
+
+    for (int i = 0; i < n; i++) order[i] = (Ranked){ res->onsets[i].strength, i };
+    qsort(order, n, sizeof(Ranked), by_strength);
+
+    for (int r = 0; r < n; r++) {
+        int i = order[r].index;
+        float t = res->onsets[i].time_s;
+        bool clear = true;
+        for (int j = i - 1; j >= 0 && t - res->onsets[j].time_s < gap && clear; j--) clear = !keep[j];
+        for (int j = i + 1; j < n && res->onsets[j].time_s - t < gap && clear; j++) clear = !keep[j];
+        keep[i] = clear;
+    }
+
+    int kept = 0;
+    for (int i = 0; i < n; i++) {
+        if (keep[i]) sorted[kept++] = res->onsets[i].centroid;
+    }
+    qsort(sorted, kept, sizeof(float), by_float);
+    for (int l = 1; l < nl && kept > 0; l++) bounds[l] = sorted[l * kept / nl];
+
+    for (int i = 0; i < n; i++) {
+        if (!keep[i]) continue;
+        int lane = 0;
+        while (lane + 1 < nl && res->onsets[i].centroid >= bounds[lane + 1]) lane++;
+        out->notes[out->count].time_ms = (uint32_t)(res->onsets[i].time_s * 1000);
+        out->notes[out->count].lane = lane;
+        out->count++;
+    }
+
+    free(order);
+    free(keep);
+    free(sorted);
+    return 0;
+}
+
+// Nome da música: arquivo sem diretório e sem extensão
+static void song_title(const char *path, char *title, size_t size) {
+    const char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    snprintf(title, size, "%s", base);
+    char *dot = strrchr(title, '.');
+    if (dot != NULL && dot != title) *dot = '\0';
+}
+
+static int process(const char *path) {
+    double start = now_s();
+
+    Audio audio;
+    if (wav_load(path, &audio) < 0) return -1;
+
+    OnsetResult res;
+    if (onset_detect(&audio, &res) < 0) {
+        audio_free(&audio);
+        return -1;
+    }
+    double seconds = (double)audio.count / audio.rate;
+    audio_free(&audio);
+
+    Chart chart;
+    memset(&chart, 0, sizeof(chart));
+    song_title(path, chart.title, sizeof(chart.title));
+    chart.bpm = res.bpm;
+    chart.lanes = lanes;
+    int rc = 0;
+    for (int i = 0; i < LEVEL_COUNT && rc == 0; i++) {
+        rc = build_level(&res, &levels[i], &chart.levels[i]);
+        if (rc == 0) chart.level_count++;
+    }
+
+    char out[1024];
+    if (out_dir != NULL) {
+        snprintf(out, sizeof(out), "%s/%s%s", out_dir, chart.title, CHART_EXT);
+    } else {
+        snprintf(out, sizeof(out), "%s", path);
+        char *dot = strrchr(out, '.');
+        char *slash = strrchr(out, '/');
+        if (dot != NULL && (slash == NULL || dot > slash)) *dot = '\0';
+        strncat(out, CHART_EXT, sizeof(out) - strlen(out) - 1);
+    }
+    if (rc == 0) rc = chart_save(out, &chart);
+
+    if (rc == 0) {
+        printf("%s: %.1fs, %d ataques, %.1f BPM, notas %d/%d/%d, %.0f ms\n", out, seconds,
+               res.count, res.bpm, chart.levels[0].count, chart.levels[1].count,
+               chart.levels[2].count, (now_s() - start) * 1000);
+        pthread_mutex_lock(&totals_lock);
+        audio_seconds += seconds;
+        pthread_mutex_unlock(&totals_lock);
+    }
+    chart_free(&chart);
+    onset_free(&res);
+    return rc;
+}
+
+static void *worker(void *arg) {
+    (void)arg;
+    for (;;) {
+        int i = __atomic_fetch_add(&next_input, 1, __ATOMIC_RELAXED);
+        if (i >= input_count) return NULL;
+        if (process(inputs[i]) < 0) __atomic_fetch_add(&failures, 1, __ATOMIC_RELAXED);
+    }
+}
+
+int main(int argc, char **argv) {
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int opt;
+    while ((opt = getopt(argc, argv, "j:l:o:")) != -1) {
+        switch (opt) {
+        case 'j': threads = atoi(optarg); break;
+        case 'l': lanes = atoi(optarg); break;
+        case 'o': out_dir = optarg; break;
+        default:
+            fprintf(stderr, "Uso: %s [-j threads] [-l pistas] [-o diretorio] musica.wav...\n", argv[0]);
+            return 1;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "Uso: %s [-j threads] [-l pistas] [-o diretorio] musica.wav...\n", argv[0]);
+        return 1;
+    }
+    if (lanes < 1 || lanes > MAX_LANES) lanes = DEFAULT_LANES;
+
+    inputs = argv + optind;
+    input_count = argc - optind;
+    if (threads < 1) threads = 1;
+    if (threads > MAX_THREADS) threads = MAX_THREADS;
+    if (threads > input_count) threads = input_count;
+
+    double start = now_s();
+    pthread_t tids[MAX_THREADS];
+    int started = 0;
+    for (; started < threads; started++) {
+        int err = pthread_create(&tids[started], NULL, worker, NULL);
+        if (err) {
+            fprintf(stderr, "Falha ao criar thread: %s\n", strerror(err));
+            break;
+        }
+    }
+    // Faltou thread: esta mesma processa o que sobrar da fila
+    if (started < threads) {
+        worker(NULL);
+        threads = started + 1;
+    }
+    for (int i = 0; i < started; i++) pthread_join(tids[i], NULL);
+
+    double elapsed = now_s() - start;
+    printf("%d arquivos, %.0fs de audio em %.2fs com %d threads (%.0fx tempo real)\n",
+           input_count - failures, audio_seconds, elapsed, threads,
+           elapsed > 0 ? audio_seconds / elapsed : 0);
+    return failures ? 1 : 0;
+}
@@ -7,6 +7,8 @@
 #include <termios.h>
 #include <stdbool.h>
 
+#include "frame_io.h"
+
 #define WIDTH 20
 #define HEIGHT 10
 #define NOTE_TYPES 4
@@ -61,7 +63,7 @@ void update_notes(Note *notes, int note_count) {
 
 // Desenha o jogo na tela
 void draw_game(Note *notes, int note_count, int score) {
-    printf("\033[H\033[J"); // Limpa a tela
+    fio_printf("\033[H\033[J"); // Limpa a tela
     
     // Desenha as notas
     char note_chars[NOTE_TYPES] = {'1', '2', '3', '4'};
@@ -69,7 +71,7 @@ void draw_game(Note *notes, int note_count, int score) {
     
     for (int i = 0; i < note_count; i++) {
         if (notes[i].active) {
-            printf("\033[%d;%dH%s%c\033[0m", 
+            fio_printf("\033[%d;%dH%s%c\033[0m", 
                    notes[i].y + 1, 
                    i + 1, 
                    colors[notes[i].type - 1], 
@@ -78,15 +80,15 @@ void draw_game(Note *notes, int note_count, int score) {
     }
     
     // Desenha a linha de "captura"
-    printf("\033[%d;1H", HEIGHT);
+    fio_printf("\033[%d;1H", HEIGHT);
     for (int i = 0; i < WIDTH; i++) {
-        printf("-");
+        fio_printf("-");
     }
     
     // Mostra a pontuação
-    printf("\nScore: %d\n", score);
-    printf("Pressione os botões 1-4 no joystick (ou 1-4 no teclado para teste)\n");
-    printf("Pressione Q para sair\n");
+    fio_printf("\nScore: %d\n", score);
+    fio_printf("Pressione os botões 1-4 no joystick (ou 1-4 no teclado para teste)\n");
+    fio_printf("Pressione Q para sair\n");
 }
 
 // Verifica se alguma nota foi acertada
@@ -95,7 +97,7 @@ void check_hits(Note *notes, int *note_count, int button_pressed, int *score) {
         if (notes[i].active && notes[i].y == HEIGHT - 1 && notes[i].type == button_pressed) {
             notes[i].active = false;
             (*score) += 10;
-            printf("\a"); // Beep
+            fio_printf("\a"); // Beep
         }
     }
 }
@@ -114,9 +116,14 @@ int main() {
     int score = 0;
     int frame_count = 0;
     
-    printf("\033[2J"); // Limpa a tela
+    fio_init(fio_backend_from_env(), STDOUT_FILENO);
+    int joy_in = fio_add_input(joy_fd, sizeof(struct js_event));
+    int kbd_in = fio_add_input(STDIN_FILENO, 1);
+    bool quit = false;
+
+    fio_printf("\033[2J"); // Limpa a tela
     
-    while (1) {
+    while (!quit) {
         // Geração de notas
         if (frame_count % 15 == 0 && rand() % 3 == 0) {
             generate_note(notes, &note_count);
@@ -126,10 +133,16 @@ int main() {
         update_notes(notes, note_count);
         draw_game(notes, note_count, score);
         
-        // Entrada do joystick
-        if (joy_fd != -1) {
+        // Envia a tela e espera entradas até o próximo quadro (50ms)
+        struct timespec t0, t1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        int remaining = 50;
+        while (remaining > 0 && !quit) {
+            fio_frame(remaining);
+
+            // Entrada do joystick
             struct js_event e;
-            while (read(joy_fd, &e, sizeof(e)) > 0) {
+            while (joy_in >= 0 && fio_read(joy_in, &e)) {
                 if (e.type == JS_EVENT_BUTTON && e.value == 1) {
                     if (e.number < 4) { // Apenas os 4 primeiros botões
                         int button_pressed = e.number + 1;
@@ -137,23 +150,26 @@ int main() {
                     }
                 }
             }
-        }
-        
-        // Entrada do teclado (para teste)
-        char c;
-        if (read(STDIN_FILENO, &c, 1) > 0) {
-            if (c >= '1' && c <= '4') {
-                int button_pressed = c - '0';
-                check_hits(notes, &note_count, button_pressed, &score);
-            } else if (c == 'q' || c == 'Q') {
-                break;
+            
+            // Entrada do teclado (para teste)
+            char c;
+            while (fio_read(kbd_in, &c)) {
+                if (c >= '1' && c <= '4') {
+                    int button_pressed = c - '0';
+                    check_hits(notes, &note_count, button_pressed, &score);
+                } else if (c == 'q' || c == 'Q') {
+                    quit = true;
+                }
             }
+
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+            remaining = 50 - (int)((t1.tv_sec - t0.tv_sec) * 1000 +
+                                   (t1.tv_nsec - t0.tv_nsec) / 1000000);
         }
-        
-        usleep(50000); // 50ms
         frame_count++;
     }
     
+    fio_close();
     if (joy_fd != -1) close(joy_fd);
     printf("\033[0m"); // Reseta cores
     printf("Jogo encerrado. Pontuação final: %d\n", score);
@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <stdbool.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "metrics.h"
+
+// Mostra as métricas publicadas pelo guitar_hero3. Só mapeia o segmento
+// para leitura: pode rodar em qualquer ritmo sem atrasar o jogo.
+//
+//   ghstat [-i ms] [-n amostras] [segmento]
+
+#define MAX_SLOTS 64          // De versões futuras do segmento
+
+static const MtFile *map = NULL;
+static size_t map_len = 0;
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void unmap(void) {
+    if (map != NULL) munmap((void *)map, map_len);
+    map = NULL;
+}
+
+static bool open_segment(const char *name) {
+    unmap();
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) return false;
+
+    struct stat st;
+    const MtFile *f = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(MtFile)) {
+        f = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (f == MAP_FAILED) return false;
+
+    // Os slots se descrevem (tipo e nome), então versões novas com mais
+    // métricas continuam legíveis; só o tamanho do slot precisa bater
+    if (__atomic_load_n(&f->magic, __ATOMIC_ACQUIRE) != MT_MAGIC || f->slot_size != sizeof(MtSlot) ||
+        sizeof(MtFile) - sizeof(f->slots) + (size_t)f->slot_count * sizeof(MtSlot) > (size_t)st.st_size) {
+        munmap((void *)f, st.st_size);
+        return false;
+    }
+    map = f;
+    map_len = st.st_size;
+    return true;
+}
+
+static bool alive(pid_t pid) {
+    return kill(pid, 0) == 0 || errno == EPERM;
+}
+
+int main(int argc, char **argv) {
+    int interval_ms = 1000;
+    long samples = -1;
+    int opt;
+    while ((opt = getopt(argc, argv, "i:n:")) != -1) {
+        switch (opt) {
+        case 'i': interval_ms = atoi(optarg); break;
+        case 'n': samples = atol(optarg); break;
+        default:
+            fprintf(stderr, "uso: %s [-i ms] [-n amostras] [segmento]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (interval_ms < 1) interval_ms = 1;
+    const char *name = optind < argc ? argv[optind] : getenv("GH_METRICS");
+    if (name == NULL) name = MT_DEFAULT_NAME;
+    bool tty = isatty(STDOUT_FILENO);
+
+    int64_t prev[MAX_SLOTS] = {0};
+    int32_t prev_pid = 0;
+    double prev_t = 0;
+
+    for (long n = 0; samples < 0 || n < samples; n++) {
+        if (n > 0) {
+            struct timespec nap = { interval_ms / 1000, (interval_ms % 1000) * 1000000L };
+            nanosleep(&nap, NULL);
+        }
+
+        // Jogo reiniciado recria o segmento: o mapeamento antigo fica parado
+        if (map == NULL || !alive(map->pid)) open_segment(name);
+        if (map == NULL) {
+            fprintf(stderr, "Segmento %s indisponivel\n", name);
+            if (samples < 0) continue;
+            return 1;
+        }
+
+        double t = now_s();
+        bool fresh = map->pid != prev_pid;
+        int count = map->slot_count < MAX_SLOTS ? (int)map->slot_count : MAX_SLOTS;
+        time_t start = map->start_ns / 1000000000;
+
+        if (tty) printf("\033[H\033[J");
+        printf("pid %d (%s), iniciado ha %lds\n", (int)map->pid,
+               alive(map->pid) ? "rodando" : "encerrado", (long)(time(NULL) - start));
+        for (int i = 0; i < count; i++) {
+            MtSlot s;
+            mt_read(&map->slots[i], &s);
+            s.name[MT_NAME_LEN - 1] = '\0';
+            switch (s.kind) {
+            case MT_COUNTER:
+                printf("  %-20s %12lld", s.name, (long long)s.value);
+                if (!fresh) printf("  %10.1f/s", (s.value - prev[i]) / (t - prev_t));
+                printf("\n");
+                break;
+            case MT_GAUGE:
+                printf("  %-20s %12lld\n", s.name, (long long)s.value);
+                break;
+            case MT_TEXT:
+                printf("  %-20s %s\n", s.name, s.text);
+                break;
+            }
+            prev[i] = s.value;
+        }
+        fflush(stdout);
+        prev_pid = map->pid;
+        prev_t = t;
+    }
+    unmap();
+    return 0;
+}
@@ -8,6 +8,10 @@
 #include <stdbool.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <poll.h>
+#include <errno.h>
+
+#include "logger.h"
 
 // Definições da placa DE2i-150
 #define FPGA_DEVICE "/dev/my_driver"
@@ -41,7 +45,7 @@ void init_terminal() {
 // Função para escrever nos LEDs
 void write_leds(int cmd, int value) {
     if (ioctl(fpga_fd, cmd, value) < 0) {
-        perror("Erro ao escrever nos LEDs");
+        lg_perror("Erro ao escrever nos LEDs");
     }
 }
 
@@ -56,7 +60,7 @@ typedef struct {
 int init_joystick() {
     int joy_fd = open("/dev/input/js0", O_RDONLY | O_NONBLOCK);
     if (joy_fd == -1) {
-        perror("Erro ao abrir o joystick");
+        lg_perror("Erro ao abrir o joystick /dev/input/js0");
     }
     return joy_fd;
 }
@@ -174,11 +178,13 @@ void check_hits(Note *notes, int *note_count, int button) {
 
 int main() {
     srand(time(NULL));
+    lg_open(NULL);
     
     // Inicializa comunicação com a FPGA
     fpga_fd = open(FPGA_DEVICE, O_RDWR);
     if (fpga_fd < 0) {
-        perror("Erro ao abrir dispositivo FPGA");
+        lg_perror("Erro ao abrir dispositivo FPGA " FPGA_DEVICE);
+        lg_close();
         return 1;
     }
     
@@ -198,11 +204,17 @@ int main() {
         update_notes(notes, note_count);
         draw_game(notes, note_count);
         
+        // Em lotes: a alavanca gera centenas de eventos de eixo por
+        // segundo, e um read() por evento atrasava os botões
         if (joy_fd != -1) {
-            struct js_event e;
-            while (read(joy_fd, &e, sizeof(e)) > 0) {
-                if (e.type == JS_EVENT_BUTTON && e.value == 1 && e.number < 4) {
-                    check_hits(notes, &note_count, e.number + 1);
+            struct js_event batch[64];
+            ssize_t n;
+            while ((n = read(joy_fd, batch, sizeof(batch))) > 0) {
+                for (int i = 0; i < (int)(n / sizeof(batch[0])); i++) {
+                    const struct js_event *e = &batch[i];
+                    if (e->type == JS_EVENT_BUTTON && e->value == 1 && e->number < 4) {
+                        check_hits(notes, &note_count, e->number + 1);
+                    }
                 }
             }
         }
@@ -211,13 +223,28 @@ int main() {
         frame++;
     }
     
-    // Tela final
-    while (true) {
-        draw_game(notes, note_count);
-        usleep(100000);
-    }
+    // Tela final: desenha (e pisca os LEDs) uma vez só; a tela é estática,
+    // então não há o que redesenhar até alguém apertar um botão
+    draw_game(notes, note_count);
+    printf("Aperte um botao para sair\n");
+    fflush(stdout);
     
-    if (joy_fd != -1) close(joy_fd);
+    if (joy_fd != -1) {
+        struct pollfd pfd = { .fd = joy_fd, .events = POLLIN };
+        struct js_event e;
+        bool pressed = false;
+        while (!pressed && poll(&pfd, 1, -1) > 0) {
+            // Joystick desconectado: o poll volta com POLLHUP/POLLERR e o
+            // read falha para sempre; sai em vez de girar
+            if (pfd.revents & (POLLHUP | POLLERR | POLLNVAL)) break;
+            ssize_t n;
+            while ((n = read(joy_fd, &e, sizeof(e))) > 0) {
+                if (e.type == JS_EVENT_BUTTON && e.value == 1) pressed = true;
+            }
+            if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) break;
+        }
+        close(joy_fd);
+    }
 
     struct termios term;
     tcgetattr(STDIN_FILENO, &term);
@@ -226,6 +253,6 @@ int main() {
     printf("\033[?25h"); // Mostra o cursor novamente
 
     close(fpga_fd);
-    printf("\033[?25h");
+    lg_close();
     return 0;
 }
\ No newline at end of file
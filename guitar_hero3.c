@@ -7,6 +7,22 @@
 #include <sys/ioctl.h>
 #include <termios.h>
 #include <string.h>
+#include <signal.h>
+
+#include "highscore.h"
+#include "button_events.h"
+#include "frame_io.h"
+#include "rt.h"
+#include "highway.h"
+#include "chart.h"
+#include "arena.h"
+#include "library.h"
+#include "metrics.h"
+#include "versus.h"
+#include "trace.h"
+#include "onset.h"
+#include "audio_out.h"
+#include "logger.h"
 
 // Configurações da placa DE2i-150
 #define DEVICE_FILE "/dev/de2i150_altera"
@@ -16,18 +32,100 @@
 #define RD_PBUTTONS 0x00000002
 
 // Configurações do jogo
-#define WIDTH 4
-#define HEIGHT 10
+#define DEFAULT_LANES 4       // Uma pista por botão da placa (GH_LANES até 8)
+#define HEIGHT 10             // Ticks que a nota leva do topo até a linha
 #define NOTE_DELAY 150000
 #define MAX_MISSES 3
 #define NOTE_SPAWN_RATE 15
+#define FRAME_NS (1000000000ull / 60)
+#define LED_PULSE_NS 50000000ull
+#define HS_SHOWN 5
+#define SELECT_SHOWN 10       // Músicas visíveis na seleção
+#define PREPARE_NS 1000000000ull // Tela "Preparando" antes da música
+#define WHAMMY_AXIS 3         // Eixos do controle (GH_AXES=alavanca,inclinação)
+#define TILT_AXIS 4
+#define SUSTAIN_NS 400000000ull // Quanto a nota acertada soa
+#define TILT_THRESHOLD 20000
+#define ENERGY_MAX 1000
+#define ENERGY_WHAMMY_DIV 64  // Unidades do eixo por ponto de energia
+#define POWER_DRAIN 2         // Energia gasta por quadro com o bônus (~8 s)
+#define SPEED_MIN 50          // Velocidades do modo treino, em % da normal
+#define SPEED_STEP 10
+#define SNAP_INTERVAL_NS 2000000000ull // Um retrato do estado por seção da música
+#define SNAP_RING 256         // Seções guardadas (potência de 2, ~8 min)
+#define REWIND_BACK_NS 1000000000ull // Voltar cai pelo menos isso para trás
+
+// Músicas disponíveis na seleção
+// O tick não move mais as notas; ele só define o ritmo da música: a nota
+// leva HEIGHT ticks para cair, sai uma a cada spawn_rate ticks e pode ser
+// acertada até meio tick antes ou depois da linha. Músicas da biblioteca
+// (GH_LIBRARY, partituras geradas pelo ghchart) seguem as notas dela em
+// vez de sortear
+typedef struct {
+    const char *title;
+    int spawn_rate;           // Ticks entre notas
+    int note_delay;           // Duração do tick em us
+    const LibEntry *entry;    // NULL = notas aleatórias
+} Song;
+
+const Song random_songs[] = {
+    { "aleatorio facil", NOTE_SPAWN_RATE + 5, NOTE_DELAY + 30000, NULL },
+    { "aleatorio", NOTE_SPAWN_RATE, NOTE_DELAY, NULL },
+    { "aleatorio dificil", NOTE_SPAWN_RATE - 7, NOTE_DELAY - 40000, NULL },
+};
+#define RANDOM_SONGS (int)(sizeof(random_songs) / sizeof(random_songs[0]))
+
+Song *songs = (Song *)random_songs;
+int song_count = RANDOM_SONGS;
+LibStats lib_stats;
+
+// Estados do jogo. Fora de ST_PLAYING nada acorda o processo além de
+// botões, teclas ou sinais, e a tela só é redesenhada quando muda
+typedef enum {
+    ST_ATTRACT,
+    ST_SELECT,
+    ST_PLAYING,
+    ST_PAUSED,
+    ST_RESULTS,
+    ST_QUIT
+} GameState;
 
 // Variáveis globais
 int score = 0;
 int consecutive_misses = 0;
 bool game_active = true;
+bool paused = false;
 int dev_fd;
 struct termios original_termios;
+int final_rank = -1;
+int current_song = 1;
+int lanes = DEFAULT_LANES;
+int frame = 0;
+uint64_t next_tick = 0;
+uint64_t song_start_ns = 0;   // Instante monotônico do tempo zero da música
+int practice_pct = 100;       // Velocidade escolhida para treinar (GH_PRACTICE)
+int speed_pct = 100;          // Velocidade da música atual
+Audio song_audio;             // <partitura>.wav, tocado só com GH_AUDIO
+uint64_t paused_at_ns = 0;
+uint64_t next_spawn_ns = 0;   // Tempo de batida da próxima nota gerada
+int chart_next = 0;           // Próxima nota da partitura
+unsigned note_seed = 0;       // Gerador das notas aleatórias (rand_r)
+bool song_finished = false;
+bool rewound = false;         // A partida voltou a uma seção (treino)
+bool user_quit = false;       // Jogador encerrou com 'q': a partida não vale
+uint64_t song_end_ns = 0;     // Instante monotônico em que a partida acabou
+bool versus_round = false;    // A música atual é contra o outro gabinete
+VsClock vs_clock;             // Última medida do relógio do outro (versus)
+int whammy_axis = WHAMMY_AXIS;
+int tilt_axis = TILT_AXIS;
+BeAxes axes;
+int whammy_last = 0;
+uint64_t sustain_until_ns = 0; // Tempo da música até quando a nota soa
+int energy = 0;
+bool power_active = false;
+uint64_t green_off_ns = 0;
+uint64_t red_off_ns = 0;
+volatile sig_atomic_t quit_requested = 0;
 
 // Inicialização do terminal
 void init_terminal() {
@@ -41,190 +139,950 @@ void init_terminal() {
     tcsetattr(STDIN_FILENO, TCSANOW, &new_termios);
     
     printf("\033[?25l\033[2J\033[H");
+    fflush(stdout);
+    fio_init(fio_backend_from_env(), STDOUT_FILENO);
 }
 
 void restore_terminal() {
+    fio_close();
     tcsetattr(STDIN_FILENO, TCSANOW, &original_termios);
     printf("\033[?25h\033[2J\033[H");
 }
 
 // Controle de hardware
+const char *hw_command_name(int command) {
+    switch (command) {
+    case WR_R_DISPLAY:  return "ioctl WR_R_DISPLAY";
+    case WR_RED_LEDS:   return "ioctl WR_RED_LEDS";
+    case WR_GREEN_LEDS: return "ioctl WR_GREEN_LEDS";
+    case RD_PBUTTONS:   return "ioctl RD_PBUTTONS";
+    default:            return "ioctl";
+    }
+}
+
 void write_hw(int command, unsigned long value) {
+    mt_add(MT_IOCTLS, 1);
+    tr_begin_arg(hw_command_name(command), value);
     ioctl(dev_fd, command, value);
+    tr_end(hw_command_name(command));
 }
 
 unsigned long read_hw(int command) {
     unsigned long value = 0;
+    mt_add(MT_IOCTLS, 1);
+    tr_begin(hw_command_name(command));
     ioctl(dev_fd, command, &value);
+    tr_end(hw_command_name(command));
     return value;
 }
 
 // Estrutura do jogo
 typedef struct {
     int column;
-    int position;
+    uint64_t time_ns;         // Tempo da música em que cruza a linha
     bool active;
 } Note;
 
-Note notes[WIDTH * HEIGHT * 2];
+// Tudo o que a música usa sai da arena, reservada em load_song: a
+// partitura e o pool de notas, dimensionado pelo máximo de notas que
+// podem estar na pista ao mesmo tempo
+Arena song_arena;
+ChartLevel song_level;
+const ChartLevel *chart = NULL;
+Note *notes = NULL;
+int note_capacity = 0;
 int note_count = 0;
 
-// Geração de notas
-void spawn_note() {
-    if (note_count < WIDTH * HEIGHT * 2) {
-        notes[note_count].column = rand() % WIDTH;
-        notes[note_count].position = 0;
-        notes[note_count].active = true;
-        note_count++;
+// Nota no retrato: só as ativas, com o tempo em us (cabe em 32 bits)
+typedef struct {
+    uint32_t time_us;
+    uint8_t column;
+} SnapNote;
+
+// Estado da partida no começo de uma seção: tudo o que update_game e
+// handle_buttons mudam, inclusive o gerador das notas aleatórias. O anel
+// é indexado pelo número da seção, então achar a seção de um tempo da
+// música é uma conta, e voltar a ela é copiar o retrato de volta
+typedef struct {
+    int64_t section;          // time_ns / SNAP_INTERVAL_NS; -1 = vazio
+    uint64_t time_ns;
+    uint64_t next_spawn_ns;
+    uint64_t sustain_until_ns;
+    unsigned note_seed;
+    int chart_next;
+    int score;
+    int consecutive_misses;
+    int energy;
+    bool power_active;
+    int note_count;
+    SnapNote *notes;          // note_capacity posições em snap_arena
+} Snapshot;
+
+Snapshot snaps[SNAP_RING];
+Arena snap_arena;
+int64_t snap_newest = -1;
+uint64_t next_snap_ns = 0;    // Tempo da música do próximo retrato
+
+uint64_t travel_ns(const Song *song) {
+    return (uint64_t)HEIGHT * song->note_delay * 1000;
+}
+
+uint64_t hit_window_ns(const Song *song) {
+    return (uint64_t)song->note_delay * 500;
+}
+
+// Tempo da música no instante monotônico t. No treino ele anda mais
+// devagar, e com ele a queda das notas e as janelas de acerto
+uint64_t song_time(uint64_t t) {
+    return (t - song_start_ns) * speed_pct / 100;
+}
+
+// Geração de notas, reaproveitando posições livres. O pool comporta as
+// notas de um intervalo de travel + window (ver load_song)
+void spawn_note(int column, uint64_t hit_time) {
+    for (int i = 0; i < note_capacity; i++) {
+        if (!notes[i].active) {
+            notes[i].column = column;
+            notes[i].time_ns = hit_time;
+            notes[i].active = true;
+            if (i >= note_count) note_count = i + 1;
+            return;
+        }
     }
+    // Não deveria acontecer com o pool de load_song; se acontecer, aparece
+    lg_warn("Pool de notas cheio, nota descartada");
 }
 
-// Atualização do jogo
-void update_game() {
-    // Movimenta as notas
-    for (int i = 0; i < note_count; i++) {
-        if (notes[i].active) {
-            notes[i].position++;
-            if (notes[i].position >= HEIGHT) {
-                notes[i].active = false;
-                consecutive_misses++;
-                if (consecutive_misses >= MAX_MISSES) {
-                    game_active = false;
-                    write_hw(WR_RED_LEDS, 0xFF);
-                }
-            }
+// Acende LEDs por LED_PULSE_NS sem parar o quadro; update_game apaga
+void pulse_leds(int command, unsigned long value) {
+    write_hw(command, value);
+    uint64_t off = be_now_ns() + LED_PULSE_NS;
+    if (command == WR_GREEN_LEDS) green_off_ns = off;
+    else red_off_ns = off;
+}
+
+void lose_note() {
+    mt_add(MT_MISSES, 1);
+    consecutive_misses++;
+    if (consecutive_misses >= MAX_MISSES) {
+        game_active = false;
+        red_off_ns = 0;
+        write_hw(WR_RED_LEDS, 0xFF);
+    }
+}
+
+// Alavanca e inclinação, lidas uma vez por quadro (be_axes já juntou os
+// eventos do quadro num valor por eixo). Mexer a alavanca enquanto a nota
+// acertada soa enche a energia; inclinar o braço com pelo menos metade
+// dela liga o bônus de pontos em dobro, que dura até esvaziar
+void update_axes(uint64_t now) {
+    be_axes(&axes);
+    if (!axes.present) return;
+    tr_instant("axes", axes.coalesced);
+
+    int whammy = axes.value[whammy_axis];
+    if (now < sustain_until_ns && !power_active) {
+        energy += abs(whammy - whammy_last) / ENERGY_WHAMMY_DIV;
+        if (energy > ENERGY_MAX) energy = ENERGY_MAX;
+    }
+    whammy_last = whammy;
+
+    if (!power_active && energy >= ENERGY_MAX / 2 && abs(axes.value[tilt_axis]) > TILT_THRESHOLD) {
+        power_active = true;
+    }
+    if (power_active) {
+        energy -= POWER_DRAIN;
+        if (energy <= 0) {
+            energy = 0;
+            power_active = false;
         }
     }
 }
 
-// Renderização do jogo
-void render_game() {
-    char screen[HEIGHT][WIDTH+1];
-    
-    // Inicializa a tela
-    for (int y = 0; y < HEIGHT; y++) {
-        for (int x = 0; x < WIDTH; x++) {
-            screen[y][x] = '.';
+void snap_clear() {
+    for (int i = 0; i < SNAP_RING; i++) snaps[i].section = -1;
+    snap_newest = -1;
+    next_snap_ns = 0;
+}
+
+// Retrato do estado no tempo da música now, antes das notas deste quadro
+void snap_take(uint64_t now) {
+    int64_t section = now / SNAP_INTERVAL_NS;
+    Snapshot *s = &snaps[section & (SNAP_RING - 1)];
+    s->section = section;
+    s->time_ns = now;
+    s->next_spawn_ns = next_spawn_ns;
+    s->sustain_until_ns = sustain_until_ns;
+    s->note_seed = note_seed;
+    s->chart_next = chart_next;
+    s->score = score;
+    s->consecutive_misses = consecutive_misses;
+    s->energy = energy;
+    s->power_active = power_active;
+
+    int n = 0;
+    for (int i = 0; i < note_count; i++) {
+        if (notes[i].active) s->notes[n++] = (SnapNote){ notes[i].time_ns / 1000, notes[i].column };
+    }
+    s->note_count = n;
+    snap_newest = section;
+    next_snap_ns = (section + 1) * SNAP_INTERVAL_NS;
+}
+
+// Retrato mais recente até o tempo t, direto pelo número da seção. Se a
+// seção já saiu do anel, fica o mais antigo que sobrou
+const Snapshot *snap_find(uint64_t t) {
+    if (snap_newest < 0) return NULL;
+    int64_t section = t / SNAP_INTERVAL_NS;
+    int64_t oldest = snap_newest - SNAP_RING + 1;
+    if (oldest < 0) oldest = 0;
+    if (section > snap_newest) section = snap_newest;
+    for (; section >= oldest; section--) {
+        const Snapshot *s = &snaps[section & (SNAP_RING - 1)];
+        if (s->section == section && s->time_ns <= t) return s;
+    }
+    const Snapshot *s = &snaps[oldest & (SNAP_RING - 1)];
+    return s->section == oldest ? s : NULL;
+}
+
+// Copia o retrato de volta. As seções depois dele são de outra história e
+// vão sendo trocadas conforme a partida passa por elas de novo
+void snap_restore(const Snapshot *s) {
+    next_spawn_ns = s->next_spawn_ns;
+    sustain_until_ns = s->sustain_until_ns;
+    note_seed = s->note_seed;
+    chart_next = s->chart_next;
+    score = s->score;
+    consecutive_misses = s->consecutive_misses;
+    energy = s->energy;
+    power_active = s->power_active;
+
+    memset(notes, 0, note_capacity * sizeof(Note));
+    for (int i = 0; i < s->note_count; i++) {
+        notes[i] = (Note){ s->notes[i].column, (uint64_t)s->notes[i].time_us * 1000, true };
+    }
+    note_count = s->note_count;
+    snap_newest = s->section;
+    next_snap_ns = (s->section + 1) * SNAP_INTERVAL_NS;
+}
+
+// Volta a partida para a seção de pelo menos REWIND_BACK_NS antes do
+// tempo da música from e acerta o relógio para que o instante monotônico
+// at caia no retrato. Não vale no versus
+bool rewind_song(uint64_t from, uint64_t at) {
+    if (versus_round) return false;
+    const Snapshot *s = snap_find(from > REWIND_BACK_NS ? from - REWIND_BACK_NS : 0);
+    if (s == NULL) return false;
+
+    snap_restore(s);
+    game_active = true;
+    song_finished = false;
+    rewound = true;
+    song_start_ns = at - s->time_ns * 100 / speed_pct;
+    au_set_start(song_start_ns);
+    mt_set(MT_SCORE, score);
+    write_hw(WR_R_DISPLAY, score);
+    tr_instant("rewind", (long)(s->time_ns / 1000000));
+    return true;
+}
+
+// Atualização do jogo no tempo da música now
+void update_game(uint64_t now) {
+    const Song *song = &songs[current_song];
+    uint64_t travel = travel_ns(song);
+    uint64_t window = hit_window_ns(song);
+    tr_begin("update_game");
+
+    if (now >= next_snap_ns) snap_take(now);
+
+    // Notas que passaram da janela viram erro. Antes do spawn, para o pool
+    // só ter as notas com tempo entre now - window e now + travel
+    for (int i = 0; i < note_count; i++) {
+        if (notes[i].active && now > notes[i].time_ns + window) {
+            notes[i].active = false;
+            lose_note();
         }
-        screen[y][WIDTH] = '\0';
     }
-    
-    // Coloca as notas na tela
+
+    // A nota aparece no topo travel antes de chegar à linha. A partitura
+    // começa depois de travel, para a primeira nota ter tempo de cair.
+    // Depois de um quadro atrasado, as que já passaram da janela viram
+    // erro direto, sem ocupar o pool
+    tr_begin("spawn");
+    if (chart != NULL) {
+        while (chart_next < chart->count) {
+            const ChartNote *cn = &chart->notes[chart_next];
+            uint64_t hit = travel + (uint64_t)cn->time_ms * 1000000;
+            if (hit > now + travel) break;
+            if (now > hit + window) lose_note();
+            else spawn_note(cn->lane % lanes, hit);
+            chart_next++;
+        }
+    } else {
+        while (next_spawn_ns <= now + travel) {
+            int column = rand_r(&note_seed) % lanes;
+            if (now > next_spawn_ns + window) lose_note();
+            else spawn_note(column, next_spawn_ns);
+            next_spawn_ns += (uint64_t)song->spawn_rate * song->note_delay * 1000;
+        }
+    }
+    tr_end("spawn");
+    update_axes(now);
+
+    // Partitura acabou e não sobrou nota na pista: fim da música
+    if (chart != NULL && chart_next >= chart->count) {
+        bool pending = false;
+        for (int i = 0; i < note_count && !pending; i++) pending = notes[i].active;
+        if (!pending) {
+            song_finished = true;
+            game_active = false;
+        }
+    }
+
+    uint64_t mono = be_now_ns();
+    if (green_off_ns && mono >= green_off_ns) {
+        write_hw(WR_GREEN_LEDS, 0);
+        green_off_ns = 0;
+    }
+    if (red_off_ns && mono >= red_off_ns) {
+        write_hw(WR_RED_LEDS, 0);
+        red_off_ns = 0;
+    }
+    tr_end("update_game");
+}
+
+// Limpa a tela e força a pista e o placar a serem redesenhados
+void clear_screen() {
+    fio_printf("\033[2J\033[H");
+    hw_invalidate();
+}
+
+// Placar da música, lido direto do arquivo mapeado
+void render_highscores(const Song *song) {
+    HsEntry top[HS_SHOWN];
+    int n = hs_top(hs_song_id(song->title), top, HS_SHOWN);
+    if (n == 0) return;
+
+    fio_printf("\nMelhores pontuacoes:\n");
+    for (int i = 0; i < n; i++) {
+        fio_printf("%s%d. %-*s %6u\033[0m\n", i == final_rank ? "\033[33m" : "",
+                   i + 1, HS_NAME_LEN, top[i].name, top[i].score);
+    }
+}
+
+// Renderização do jogo no tempo da música now
+void render_game(uint64_t now) {
+    uint64_t travel = travel_ns(&songs[current_song]);
+    tr_begin("render_game");
+
+    hw_begin();
     for (int i = 0; i < note_count; i++) {
         if (notes[i].active) {
-            int y = notes[i].position;
-            int x = notes[i].column;
-            if (y >= 0 && y < HEIGHT && x >= 0 && x < WIDTH) {
-                screen[y][x] = '1' + x;
-            }
+            double ahead = (double)(int64_t)(notes[i].time_ns - now);
+            hw_note(notes[i].column, 1.0 - ahead / travel);
         }
     }
-    
-    // Desenha a tela
-    printf("\033[H");
-    for (int y = 0; y < HEIGHT; y++) {
-        printf("%s\n", screen[y]);
-    }
-    
-    // Linha de base
-    for (int x = 0; x < WIDTH; x++) printf("--");
-    printf("\n");
-    
-    printf("Score: %d | Erros: %d/%d\n", score, consecutive_misses, MAX_MISSES);
-    
+    hw_hud(score, consecutive_misses, MAX_MISSES);
+    hw_peer(versus_round && vs_peer()->seen ? vs_peer()->score : -1);
+    hw_power(axes.present ? energy * 100 / ENERGY_MAX : -1, power_active);
+    hw_flush();
+    tr_end("render_game");
+}
+
+// Fim da partida abaixo da pista. Fora da música: com a thread de desenho
+// rodando, só ela escreve no terminal
+void render_result() {
     if (!game_active) {
-        printf("\n\033[31mGAME OVER! Pontuacao final: %d\033[0m\n", score);
+        fio_printf("\033[%d;1H", hw_hud_row() + 1);
+        if (song_finished) {
+            fio_printf("\n\033[32mFIM DA MUSICA! Pontuacao final: %d\033[0m\n", score);
+        } else {
+            fio_printf("\n\033[31mGAME OVER! Pontuacao final: %d\033[0m\n", score);
+        }
+        if (versus_round) {
+            const VsPeer *peer = vs_peer();
+            fio_printf("Adversario: %d%s\n", peer->score, peer->finished ? "" : " (ainda jogando)");
+        }
+        render_highscores(&songs[current_song]);
     }
 }
 
-// Verificação de acertos
-void check_input() {
-    static unsigned long prev_buttons = 0;
-    unsigned long buttons = read_hw(RD_PBUTTONS);
-    unsigned long changes = buttons ^ prev_buttons;
-    
-    for (int btn = 0; btn < WIDTH; btn++) {
+// Acrescenta uma música por nível de cada partitura da biblioteca em
+// GH_LIBRARY. Só o índice é lido aqui; as notas vêm na hora de jogar
+void load_library() {
+    const char *dir = getenv("GH_LIBRARY");
+    if (dir == NULL || lib_open(dir, NULL, &lib_stats) < 0) return;
+
+    Song *all = malloc((RANDOM_SONGS + lib_count()) * sizeof(Song));
+    if (all == NULL) return;
+    memcpy(all, random_songs, sizeof(random_songs));
+    song_count = RANDOM_SONGS;
+
+    for (int i = 0; i < lib_count(); i++) {
+        const LibEntry *e = lib_entry(i);
+        char title[CHART_TITLE_LEN + CHART_LEVEL_LEN + 4];
+        snprintf(title, sizeof(title), "%s (%s)", e->title, e->level);
+        all[song_count++] = (Song){ strdup(title), NOTE_SPAWN_RATE, NOTE_DELAY, e };
+    }
+    songs = all;
+}
+
+// Só os bits das pistas: com GH_DEVICE=/dev/null o comando 2 é o FIGETBSZ
+// genérico e devolve o tamanho de bloco (4096), que viraria um aperto
+unsigned long read_buttons() {
+    return read_hw(RD_PBUTTONS) & ((1u << HW_MAX_LANES) - 1);
+}
+
+// Verificação de acertos; t é o tempo da música do evento
+void handle_buttons(unsigned long buttons, unsigned long changes, uint64_t t) {
+    uint64_t window = hit_window_ns(&songs[current_song]);
+
+    for (int btn = 0; btn < lanes; btn++) {
         if (changes & (1 << btn)) {
             if (buttons & (1 << btn)) {
-                // Botão pressionado
-                bool hit = false;
+                // Botão pressionado: acerta a nota mais próxima da linha
+                int best = -1;
+                uint64_t best_dist = window + 1;
                 
                 for (int i = 0; i < note_count; i++) {
-                    if (notes[i].active && notes[i].position == HEIGHT-1 && notes[i].column == btn) {
-                        notes[i].active = false;
-                        score += 10;
-                        consecutive_misses = 0;
-                        hit = true;
-                        
-                        write_hw(WR_GREEN_LEDS, 1 << btn);
-                        usleep(50000);
-                        write_hw(WR_GREEN_LEDS, 0);
-                        break;
+                    if (notes[i].active && notes[i].column == btn) {
+                        uint64_t dist = notes[i].time_ns > t ? notes[i].time_ns - t : t - notes[i].time_ns;
+                        if (dist < best_dist) {
+                            best = i;
+                            best_dist = dist;
+                        }
                     }
                 }
                 
-                if (!hit) {
-                    consecutive_misses++;
-                    write_hw(WR_RED_LEDS, 1 << btn);
-                    usleep(50000);
-                    write_hw(WR_RED_LEDS, 0);
-                    
-                    if (consecutive_misses >= MAX_MISSES) {
-                        game_active = false;
-                        write_hw(WR_RED_LEDS, 0xFF);
-                    }
+                if (best >= 0) {
+                    notes[best].active = false;
+                    score += power_active ? 20 : 10;
+                    consecutive_misses = 0;
+                    sustain_until_ns = t + SUSTAIN_NS;
+                    mt_add(MT_HITS, 1);
+                    mt_set(MT_SCORE, score);
+                    pulse_leds(WR_GREEN_LEDS, 1 << btn);
+                } else {
+                    pulse_leds(WR_RED_LEDS, 1 << btn);
+                    lose_note();
                 }
                 
                 write_hw(WR_R_DISPLAY, score);
             }
         }
     }
-    
-    prev_buttons = buttons;
+}
+
+// Dorme até o próximo quadro, acordando só quando um botão muda
+void check_input(uint64_t deadline_ns) {
+    ButtonEvent ev;
+    tr_begin("check_input");
+    while (game_active && !quit_requested) {
+        // Todo despertar entra no histograma, medido contra o prazo do
+        // quadro: antes dele (entrada) conta como zero, e uma espera presa
+        // aparece como atraso em vez de sumir da conta
+        int r = be_wait_until(&ev, deadline_ns);
+        rt_record_wakeup(deadline_ns, be_now_ns());
+        if (r <= 0) break;
+        mt_add(MT_INPUT_EVENTS, 1);
+        tr_instant("input", ev.key ? (long)ev.key : (long)ev.buttons);
+
+        if (ev.key == 'p' || ev.key == 27) {
+            paused = true;
+            break;
+        }
+        if (ev.key == 'q') {
+            game_active = false;
+            user_quit = true;
+            break;
+        }
+        if (ev.key == 'r') {
+            rewind_song(song_time(ev.time_ns), ev.time_ns);
+            continue;
+        }
+        handle_buttons(ev.buttons, ev.changes, song_time(ev.time_ns));
+    }
+    tr_end("check_input");
+}
+
+void on_signal(int sig) {
+    (void)sig;
+    quit_requested = 1;
+}
+
+// Bloqueia até um aperto de botão ou tecla; false se pediram para sair ou
+// chegou um convite do versus (ver interrupted)
+bool wait_press(ButtonEvent *ev) {
+    while (!quit_requested) {
+        if (be_wait(ev, -1) <= 0) {
+            if (vs_invited()) return false;
+            continue;
+        }
+        mt_add(MT_INPUT_EVENTS, 1);
+        tr_instant("input", ev->key ? (long)ev->key : (long)ev->buttons);
+        if (ev->key || (ev->changes & ev->buttons)) return true;
+    }
+    return false;
+}
+
+int pressed_button(const ButtonEvent *ev) {
+    unsigned long pressed = ev->changes & ev->buttons;
+    for (int btn = 0; btn < HW_MAX_LANES; btn++) {
+        if (pressed & (1 << btn)) return btn;
+    }
+    return -1;
+}
+
+// Máximo de notas da partitura cujo tempo cabe num intervalo de span_ns
+int max_on_screen(const ChartLevel *level, uint64_t span_ns) {
+    int best = 0;
+    for (int lo = 0, hi = 0; hi < level->count; hi++) {
+        while ((uint64_t)(level->notes[hi].time_ms - level->notes[lo].time_ms) * 1000000 > span_ns) lo++;
+        if (hi - lo + 1 > best) best = hi - lo + 1;
+    }
+    return best;
+}
+
+int find_song(uint32_t song_id) {
+    for (int i = 0; i < song_count; i++) {
+        if (hs_song_id(songs[i].title) == song_id) return i;
+    }
+    return -1;
+}
+
+// Convite do outro gabinete: só dá para aceitar música que temos aqui
+bool has_song(uint32_t song_id) {
+    return find_song(song_id) >= 0;
+}
+
+// Reserva a arena da música e carrega nela a partitura e o pool de notas.
+// Depois daqui o laço do quadro não aloca nem libera nada
+bool load_song(const Song *song) {
+    uint64_t span = travel_ns(song) + hit_window_ns(song);
+    const LibEntry *e = song->entry;
+    size_t size;
+
+    // O índice já diz quantas notas o nível tem; o pool nunca passa disso
+    if (e != NULL) {
+        note_capacity = e->note_count + 1;
+        size = e->note_count * sizeof(ChartNote) + note_capacity * sizeof(Note) + 2 * ARENA_ALIGN;
+    } else {
+        note_capacity = (int)(span / ((uint64_t)song->spawn_rate * song->note_delay * 1000)) + 2;
+        size = note_capacity * sizeof(Note);
+    }
+    if (arena_reserve(&song_arena, size) < 0) return false;
+
+    chart = NULL;
+    if (e != NULL) {
+        char path[LIB_PATH_LEN * 2];
+        memset(&song_level, 0, sizeof(song_level));
+        song_level.count = e->note_count;
+        song_level.notes = arena_alloc(&song_arena, e->note_count * sizeof(ChartNote));
+        if (song_level.notes == NULL || lib_path(e, path, sizeof(path)) < 0 ||
+            chart_read_level(path, e->chart_offset, e->note_count, song_level.notes) < 0) {
+            return false;
+        }
+        chart = &song_level;
+        note_capacity = max_on_screen(chart, span) + 1;
+    }
+
+    notes = arena_alloc(&song_arena, note_capacity * sizeof(Note));
+    if (notes == NULL) return false;
+    memset(notes, 0, note_capacity * sizeof(Note));
+
+    // Os retratos guardam só as notas ativas, no máximo o pool inteiro. A
+    // arena deles só é conhecida depois de ler a partitura
+    size = (size_t)SNAP_RING * note_capacity * sizeof(SnapNote);
+    if (arena_reserve(&snap_arena, size) < 0) return false;
+    SnapNote *snap_notes = arena_alloc(&snap_arena, size);
+    if (snap_notes == NULL) return false;
+    for (int i = 0; i < SNAP_RING; i++) snaps[i].notes = snap_notes + (size_t)i * note_capacity;
+    snap_clear();
+    return true;
+}
+
+// Áudio da música da biblioteca: o WAV com o nome da partitura, no mesmo
+// diretório. Sem ele (ou sem GH_AUDIO) a música toca muda
+void load_audio(const LibEntry *e) {
+    au_stop();
+    audio_free(&song_audio);
+    char path[LIB_PATH_LEN * 2];
+    if (e == NULL || !au_enabled() || lib_path(e, path, sizeof(path)) < 0) return;
+
+    char *dot = strrchr(path, '.');
+    if (dot == NULL || (size_t)(dot - path) + sizeof(".wav") > sizeof(path)) return;
+    strcpy(dot, ".wav");
+    if (access(path, R_OK) == 0 && wav_load(path, &song_audio) < 0) audio_free(&song_audio);
+}
+
+// Espera até o instante t atendendo o socket do versus; apertos antes da
+// hora não contam
+void wait_until(uint64_t t) {
+    ButtonEvent ev;
+    while (be_now_ns() < t && !quit_requested) be_wait_until(&ev, t);
+}
+
+// Zera o estado para uma nova partida, sem reabrir nada. A música começa
+// no instante monotônico start_ns
+bool start_song(uint64_t start_ns) {
+    // Daqui até o fim da música um convite do versus leva BUSY
+    vs_set_busy(true);
+    if (!load_song(&songs[current_song])) return false;
+    load_audio(songs[current_song].entry);
+
+    score = 0;
+    consecutive_misses = 0;
+    game_active = true;
+    paused = false;
+    final_rank = -1;
+    note_count = 0;
+    frame = 0;
+    green_off_ns = red_off_ns = 0;
+    paused_at_ns = 0;
+    next_spawn_ns = travel_ns(&songs[current_song]);
+    chart_next = 0;
+    song_finished = false;
+    user_quit = false;
+    energy = 0;
+    power_active = false;
+    sustain_until_ns = 0;
+    rewound = false;
+    // No versus os dois gabinetes jogam na velocidade normal
+    speed_pct = versus_round ? 100 : practice_pct;
+    mt_set(MT_SCORE, 0);
+    mt_text(MT_SONG, songs[current_song].title);
+
+    write_hw(WR_R_DISPLAY, 0);
+    write_hw(WR_RED_LEDS, 0);
+    write_hw(WR_GREEN_LEDS, 0);
+
+    clear_screen();
+    fio_printf("%s\n", songs[current_song].title);
+    if (versus_round) {
+        fio_printf("Versus (ida e volta %.2f ms, relogio %+.3f ms)\n",
+                   vs_clock.rtt_ns / 1e6, vs_clock.offset_ns / 1e6);
+    }
+    if (speed_pct < 100) fio_printf("Treino a %d%% da velocidade\n", speed_pct);
+    fio_printf("Preparando...\n");
+    fio_frame(0);
+    // A thread de áudio já sobe aqui e fica em silêncio até start_ns; a
+    // partitura começa travel depois do tempo zero, e o áudio com ela
+    if (song_audio.count > 0) au_play(&song_audio, start_ns, travel_ns(&songs[current_song]), speed_pct);
+    wait_until(start_ns);
+    clear_screen();
+    song_start_ns = start_ns;
+    return true;
+}
+
+// Entra na música para a qual o outro gabinete convidou, no instante
+// combinado. false se não há convite ou ele já passou
+bool join_song() {
+    uint32_t song_id, seed;
+    uint64_t start_ns;
+    if (!vs_take_start(&song_id, &seed, &start_ns)) return false;
+
+    int i = find_song(song_id);
+    if (i < 0 || start_ns < be_now_ns()) return false;
+    current_song = i;
+    versus_round = true;
+    memset(&vs_clock, 0, sizeof(vs_clock)); // Só quem convida mede
+    note_seed = seed;
+    return start_song(start_ns);
+}
+
+// Começa a música escolhida aqui. No versus convida o outro gabinete; a
+// mesma semente faz as músicas aleatórias saírem iguais nos dois. Sem
+// resposta, joga sozinho
+bool play_song() {
+    uint32_t seed = rand();
+    uint64_t start_ns = be_now_ns() + PREPARE_NS;
+    versus_round = false;
+
+    if (vs_enabled()) {
+        fio_printf("\nChamando o adversario...\n");
+        fio_frame(0);
+        start_ns = be_now_ns() + VS_LEAD_NS;
+        int r = vs_start(hs_song_id(songs[current_song].title), seed, start_ns, &vs_clock);
+        if (r > 0) return join_song();
+        versus_round = r == 0;
+    }
+    note_seed = seed;
+    return start_song(start_ns);
+}
+
+// wait_press voltou sem aperto: pediram para sair ou o outro gabinete
+// começou uma música
+GameState interrupted() {
+    if (quit_requested) return ST_QUIT;
+    return join_song() ? ST_PLAYING : ST_SELECT;
+}
+
+GameState run_attract() {
+    clear_screen();
+    fio_printf("Guitar Hero DE2i-150\n\n");
+    fio_printf("Aperte qualquer botao para comecar (q sai)\n");
+    if (lib_stats.files > 0) {
+        fio_printf("\nBiblioteca: %d musicas, %d arquivos (%d relidos, %d com erro) em %.1f ms\n",
+                   song_count - RANDOM_SONGS, lib_stats.files, lib_stats.parsed, lib_stats.failed,
+                   lib_stats.elapsed_ms);
+    }
+    render_highscores(&songs[current_song]);
+    fio_frame(0);
+
+    ButtonEvent ev;
+    if (!wait_press(&ev)) return interrupted();
+    if (ev.key == 'q') return ST_QUIT;
+    return ST_SELECT;
+}
+
+GameState run_select() {
+    ButtonEvent ev;
+    bool dirty = true;
+
+    for (;;) {
+        if (dirty) {
+            clear_screen();
+            fio_printf("Escolha a musica\n\n");
+            // Janela em volta da música atual
+            int first = current_song - SELECT_SHOWN / 2;
+            if (first > song_count - SELECT_SHOWN) first = song_count - SELECT_SHOWN;
+            if (first < 0) first = 0;
+            for (int i = first; i < song_count && i < first + SELECT_SHOWN; i++) {
+                fio_printf("%s %s\n", i == current_song ? ">" : " ", songs[i].title);
+            }
+            fio_printf("\n1: anterior  2: proxima  3: jogar  4: voltar\n");
+            fio_printf("Velocidade: %d%% (v muda)\n", practice_pct);
+            render_highscores(&songs[current_song]);
+            fio_frame(0);
+            dirty = false;
+        }
+
+        if (!wait_press(&ev)) return interrupted();
+
+        int btn = pressed_button(&ev);
+        if (btn == 3 || ev.key == 'q') return ST_ATTRACT;
+        if (btn == 2 || ev.key == '\n') {
+            if (play_song()) return ST_PLAYING;
+            dirty = true;
+        }
+        if (ev.key == 'v') {
+            practice_pct = practice_pct > SPEED_MIN ? practice_pct - SPEED_STEP : 100;
+            dirty = true;
+        }
+        if (btn == 0) {
+            current_song = (current_song + song_count - 1) % song_count;
+            dirty = true;
+        } else if (btn == 1) {
+            current_song = (current_song + 1) % song_count;
+            dirty = true;
+        }
+    }
+}
+
+GameState run_playing() {
+    const Song *song = &songs[current_song];
+
+    // Voltando da pausa: o relógio da música não andou enquanto pausado
+    if (paused_at_ns) {
+        song_start_ns += be_now_ns() - paused_at_ns;
+        paused_at_ns = 0;
+        au_set_start(song_start_ns);
+        au_pause(false);
+    }
+
+    next_tick = be_now_ns();
+    // Escrever no terminal pode bloquear; com a thread de desenho isso não
+    // atrasa a simulação nem a leitura dos botões
+    bool drawer = hw_start_thread();
+    if (alloc_guard_begin) alloc_guard_begin();
+    while (game_active && !paused && !quit_requested) {
+        uint64_t now = be_now_ns();
+        tr_begin_arg("frame", frame);
+        mt_frame(now);
+        update_game(song_time(now));
+        if (versus_round) vs_report(score, consecutive_misses, !game_active);
+        render_game(song_time(now));
+
+        // O quadro inteiro sai numa única escrita (ou SQE, com GH_IO=uring)
+        if (!drawer) {
+            tr_begin("fio_frame");
+            fio_frame(0);
+            tr_end("fio_frame");
+        }
+
+        // Quadro atrasado demais: em vez de correr atrás, retoma o ritmo
+        next_tick += FRAME_NS;
+        if (next_tick + FRAME_NS < now) next_tick = now + FRAME_NS;
+        check_input(next_tick);
+        tr_end("frame");
+        frame++;
+    }
+    if (alloc_guard_end) alloc_guard_end();
+    hw_stop_thread();
+    mt_frames_stop();
+    if (versus_round) vs_report(score, consecutive_misses, !game_active);
+
+    if (paused && !quit_requested) {
+        au_pause(true);
+        paused_at_ns = be_now_ns();
+        return ST_PAUSED;
+    }
+    au_stop();
+    song_end_ns = be_now_ns();
+    if (quit_requested) return ST_QUIT;
+
+    // Partida de treino (mais lenta ou que voltou seções) ou abandonada
+    // não entra no placar
+    const char *player = getenv("GH_PLAYER");
+    final_rank = -1;
+    if (speed_pct == 100 && !rewound && !user_quit) final_rank = hs_submit(hs_song_id(song->title), player ? player : "JOGADOR", score);
+    return ST_RESULTS;
+}
+
+GameState run_paused() {
+    render_game(song_time(paused_at_ns));
+    fio_printf("\033[%d;1H\n\033[33mPAUSADO\033[0m - aperte um botao para continuar (q encerra)\n",
+               hw_hud_row());
+    if (!versus_round) {
+        uint64_t t = song_time(paused_at_ns) / 1000000000;
+        fio_printf("Em %d:%02d - r volta uma secao\n", (int)(t / 60), (int)(t % 60));
+    }
+    fio_frame(0);
+    hw_snapshot();
+
+    ButtonEvent ev;
+    if (!wait_press(&ev)) return interrupted();
+    if (ev.key == 'q') {
+        game_active = false;
+        user_quit = true;
+    }
+    // Voltar na pausa continua pausado, já mostrando a seção
+    if (ev.key == 'r' && rewind_song(song_time(paused_at_ns), paused_at_ns)) return ST_PAUSED;
+
+    // O aperto que tirou da pausa não conta como jogada
+    paused = false;
+    clear_screen();
+    return ST_PLAYING;
+}
+
+GameState run_results() {
+    render_game(song_time(be_now_ns()));
+    render_result();
+    fio_printf("\n1: jogar de novo  2: escolher musica  q: sair%s\n",
+               versus_round ? "" : "  r: voltar uma secao");
+    fio_frame(0);
+    hw_snapshot();
+
+    ButtonEvent ev;
+    for (;;) {
+        if (!wait_press(&ev)) return interrupted();
+        if (ev.key == 'q') return ST_QUIT;
+
+        // Continua do retrato antes do fim, sem recarregar a música
+        uint64_t now = be_now_ns();
+        if (ev.key == 'r' && rewind_song(song_time(song_end_ns), now)) {
+            if (song_audio.count > 0) au_play(&song_audio, song_start_ns, travel_ns(&songs[current_song]), speed_pct);
+            clear_screen();
+            return ST_PLAYING;
+        }
+
+        int btn = pressed_button(&ev);
+        if (btn == 0) return play_song() ? ST_PLAYING : ST_SELECT;
+        if (btn == 1) return ST_SELECT;
+    }
 }
 
 int main() {
     srand(time(NULL));
+    if (alloc_guard_expect) alloc_guard_expect();
+    // Antes do rt_init: a thread do log não herda a prioridade nem a CPU
+    lg_open(NULL);
+    tr_open(NULL);
+    rt_init();
     init_terminal();
     
-    // Inicializa hardware
-    dev_fd = open(DEVICE_FILE, O_RDWR);
+    // Inicializa hardware. GH_DEVICE troca o nó da placa; com /dev/null o
+    // jogo roda sem ela (os botões ficam soltos, ver read_buttons)
+    const char *device = getenv("GH_DEVICE");
+    if (device == NULL) device = DEVICE_FILE;
+    dev_fd = open(device, O_RDWR);
     if (dev_fd < 0) {
-        perror("Falha ao abrir dispositivo");
+        lg_postf(LG_ERROR, errno, "Falha ao abrir dispositivo %s", device);
         restore_terminal();
+        lg_close();
         return 1;
     }
     
+    // Placar é opcional: sem ele o jogo roda, só não guarda pontuação
+    hs_open(NULL);
+    mt_open(NULL);
+    load_library();
+    vs_open(NULL, has_song);
+    au_open(NULL);
+
+    const char *env = getenv("GH_LANES");
+    if (env != NULL) lanes = atoi(env);
+    if (lanes < 1 || lanes > HW_MAX_LANES) lanes = DEFAULT_LANES;
+    env = getenv("GH_BYTE_BUDGET");
+    hw_init(lanes, env ? atoi(env) : HW_DEFAULT_BUDGET);
+    hw_open_backend(NULL);
+
+    be_open(NULL, read_buttons);
+    be_set_keyboard(STDIN_FILENO);
+    be_open_joystick(NULL);
+    env = getenv("GH_AXES");
+    if (env != NULL) sscanf(env, "%d,%d", &whammy_axis, &tilt_axis);
+    if (whammy_axis < 0 || whammy_axis >= BE_MAX_AXES) whammy_axis = WHAMMY_AXIS;
+    if (tilt_axis < 0 || tilt_axis >= BE_MAX_AXES) tilt_axis = TILT_AXIS;
+    env = getenv("GH_PRACTICE");
+    if (env != NULL) practice_pct = atoi(env);
+    if (practice_pct < SPEED_MIN || practice_pct > 100) practice_pct = 100;
+    if (vs_enabled()) be_watch(vs_fd(), vs_service);
+
+    // Sem SA_RESTART: o sinal interrompe o poll() e o jogo sai limpo
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
     write_hw(WR_R_DISPLAY, 0);
     write_hw(WR_RED_LEDS, 0);
     write_hw(WR_GREEN_LEDS, 0);
     
-    printf("Guitar Hero DE2i-150\n");
-    printf("Preparando...\n");
-    usleep(1000000);
-    
-    int frame = 0;
-    while (game_active) {
-        // Gera novas notas
-        if (frame % NOTE_SPAWN_RATE == 0) {
-            spawn_note();
-        }
-        
-        update_game();
-        render_game();
-        check_input();
-        
-        usleep(NOTE_DELAY);
-        frame++;
-    }
-    
-    // Tela de game over
-    while (1) {
-        render_game();
-        usleep(100000);
+    rt_enter_thread(RT_GAME);
+
+    GameState state = ST_ATTRACT;
+    while (state != ST_QUIT && !quit_requested) {
+        vs_set_busy(state == ST_PLAYING || state == ST_PAUSED);
+        switch (state) {
+        case ST_ATTRACT: state = run_attract(); break;
+        case ST_SELECT:  state = run_select();  break;
+        case ST_PLAYING: state = run_playing(); break;
+        case ST_PAUSED:  state = run_paused();  break;
+        case ST_RESULTS: state = run_results(); break;
+        default:         state = ST_QUIT;       break;
+        }
     }
     
+    write_hw(WR_RED_LEDS, 0);
+    write_hw(WR_GREEN_LEDS, 0);
+
+    hw_close();
+    be_close();
+    hs_close();
+    mt_close();
+    vs_close();
+    au_close();
+    audio_free(&song_audio);
+    arena_release(&song_arena);
+    arena_release(&snap_arena);
+    lib_close();
     close(dev_fd);
     restore_terminal();
+    rt_report();
+    au_report();
+    tr_close();
+    lg_close();
     return 0;
 }
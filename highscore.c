@@ -0,0 +1,325 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <stdbool.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "highscore.h"
+#include "logger.h"
+
+static HsFile *hs_map = NULL;
+static int hs_fd = -1;
+
+// Identificador estável da música (FNV-1a), nunca zero
+uint32_t hs_song_id(const char *title) {
+    uint32_t h = 2166136261u;
+    for (const char *p = title; *p; p++) {
+        h ^= (unsigned char)*p;
+        h *= 16777619u;
+    }
+    return h ? h : 1;
+}
+
+// Trava entre processos: futex no próprio mapeamento (sem FUTEX_PRIVATE)
+static void futex_wait(uint32_t *addr, uint32_t val) {
+    struct timespec ts = {0, 10000000}; // 10ms para checar dono morto
+    syscall(SYS_futex, addr, FUTEX_WAIT, val, &ts, NULL, 0);
+}
+
+static void futex_wake(uint32_t *addr) {
+    syscall(SYS_futex, addr, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+// Sincroniza no disco as páginas que contêm o intervalo
+static void hs_sync(void *addr, size_t len) {
+    long page = sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t)addr & ~(uintptr_t)(page - 1);
+    uintptr_t end = (uintptr_t)addr + len;
+    msync((void *)start, end - start, MS_SYNC);
+}
+
+// Início do processo em ticks desde o boot (campo 22 de /proc/pid/stat),
+// 0 se ele não existe
+static uint64_t proc_start(pid_t pid) {
+    char path[64], buf[512];
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (n <= 0) return 0;
+    buf[n] = '\0';
+
+    // O nome do processo pode ter espaços e parênteses: conta do último ')'
+    char *p = strrchr(buf, ')');
+    for (int field = 2; p != NULL && field < 22; field++) p = strchr(p + 1, ' ');
+    return p != NULL ? strtoull(p + 1, NULL, 10) : 0;
+}
+
+// O dono da trava morreu? PID que não existe, ou que existe mas começou
+// em outro instante (foi reaproveitado). Enquanto o início gravado não for
+// o deste dono (ele acabou de tomar a trava) não dá para saber, e a
+// resposta é não
+static bool owner_dead(uint32_t owner) {
+    if (kill((pid_t)owner, 0) < 0 && errno == ESRCH) return true;
+    if (__atomic_load_n(&hs_map->lock_owner, __ATOMIC_ACQUIRE) != owner) return false;
+    uint64_t start = __atomic_load_n(&hs_map->lock_start, __ATOMIC_ACQUIRE);
+    if (start == 0 || __atomic_load_n(&hs_map->lock_owner, __ATOMIC_ACQUIRE) != owner ||
+        __atomic_load_n(&hs_map->lock, __ATOMIC_ACQUIRE) != owner) {
+        return false;
+    }
+    uint64_t now = proc_start((pid_t)owner);
+    return now != 0 && now != start;
+}
+
+// Grava o início do dono da trava; só depois do CAS que a deu para nós
+static void set_owner(uint32_t self) {
+    __atomic_store_n(&hs_map->lock_start, proc_start((pid_t)self), __ATOMIC_RELEASE);
+    __atomic_store_n(&hs_map->lock_owner, self, __ATOMIC_RELEASE);
+}
+
+// Um escritor que morreu no meio do commit deixou o seqlock ímpar, e os
+// leitores ficariam esperando para sempre. Só roda com a trava na mão,
+// quando nenhum commit pode estar em andamento
+static void repair_seq(void) {
+    uint32_t count = hs_map->song_count < HS_MAX_SONGS ? hs_map->song_count : HS_MAX_SONGS;
+    for (uint32_t i = 0; i < count; i++) {
+        HsSong *song = &hs_map->songs[i];
+        if (__atomic_load_n(&song->seq, __ATOMIC_RELAXED) & 1) {
+            __atomic_fetch_add(&song->seq, 1, __ATOMIC_RELEASE);
+            hs_sync(&song->seq, sizeof(song->seq));
+        }
+    }
+}
+
+static void hs_lock(void) {
+    uint32_t self = (uint32_t)getpid();
+    for (;;) {
+        uint32_t owner = 0;
+        if (__atomic_compare_exchange_n(&hs_map->lock, &owner, self, false,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            set_owner(self);
+            return;
+        }
+        // Dono morreu segurando a trava: a cópia ativa continua válida,
+        // então basta tomar a trava para nós e consertar o seqlock. Só quem
+        // ganhar o CAS mexe em lock_start; até lá lock_owner ainda é o
+        // morto, e quem olhar no meio da troca espera
+        if (owner_dead(owner)) {
+            if (__atomic_compare_exchange_n(&hs_map->lock, &owner, self, false,
+                                            __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                set_owner(self);
+                repair_seq();
+                return;
+            }
+            continue;
+        }
+        futex_wait(&hs_map->lock, owner);
+    }
+}
+
+static void hs_unlock(void) {
+    __atomic_store_n(&hs_map->lock_owner, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&hs_map->lock_start, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&hs_map->lock, 0, __ATOMIC_RELEASE);
+    futex_wake(&hs_map->lock);
+}
+
+// Conserta o seqlock deixado por um escritor morto, esperando um vivo
+// terminar o que estiver fazendo
+static void hs_recover(void) {
+    hs_lock();
+    repair_seq();
+    hs_unlock();
+}
+
+// Identificador do boot atual; vazio se não der para ler
+static void read_boot_id(char *out) {
+    memset(out, 0, HS_BOOT_ID_LEN);
+    int fd = open("/proc/sys/kernel/random/boot_id", O_RDONLY);
+    if (fd < 0) return;
+    ssize_t n = read(fd, out, HS_BOOT_ID_LEN - 1);
+    close(fd);
+    if (n > 0 && out[n - 1] == '\n') out[n - 1] = '\0';
+}
+
+// Abre (ou cria) o arquivo de placar
+int hs_open(const char *path) {
+    if (path == NULL) {
+        path = getenv("GH_HIGHSCORE_FILE");
+        if (path == NULL) path = HS_DEFAULT_FILE;
+    }
+
+    hs_fd = open(path, O_RDWR | O_CREAT, 0666);
+    if (hs_fd < 0) {
+        lg_postf(LG_ERROR, errno, "Falha ao abrir placar %s", path);
+        return -1;
+    }
+
+    // flock só na abertura, para que dois gabinetes não inicializem juntos
+    flock(hs_fd, LOCK_EX);
+
+    struct stat st;
+    if (fstat(hs_fd, &st) < 0 ||
+        (st.st_size < (off_t)sizeof(HsFile) && ftruncate(hs_fd, sizeof(HsFile)) < 0)) {
+        lg_postf(LG_ERROR, errno, "Falha ao dimensionar placar %s", path);
+        flock(hs_fd, LOCK_UN);
+        close(hs_fd);
+        hs_fd = -1;
+        return -1;
+    }
+
+    hs_map = mmap(NULL, sizeof(HsFile), PROT_READ | PROT_WRITE, MAP_SHARED, hs_fd, 0);
+    if (hs_map == MAP_FAILED) {
+        lg_postf(LG_ERROR, errno, "Falha ao mapear placar %s", path);
+        hs_map = NULL;
+        flock(hs_fd, LOCK_UN);
+        close(hs_fd);
+        hs_fd = -1;
+        return -1;
+    }
+
+    if (hs_map->magic != HS_MAGIC) {
+        memset(hs_map, 0, sizeof(HsFile));
+        hs_map->version = HS_VERSION;
+        hs_map->magic = HS_MAGIC;
+        hs_sync(hs_map, sizeof(HsFile));
+    } else if (hs_map->version != HS_VERSION) {
+        lg_error("Placar com versao %u incompativel", hs_map->version);
+        flock(hs_fd, LOCK_UN);
+        hs_close();
+        return -1;
+    }
+
+    // Trava de outro boot: o dono certamente morreu, e o PID gravado pode
+    // ser de qualquer processo agora
+    char boot[HS_BOOT_ID_LEN];
+    read_boot_id(boot);
+    if (memcmp(boot, hs_map->boot_id, HS_BOOT_ID_LEN) != 0) {
+        hs_map->lock = 0;
+        hs_map->lock_start = 0;
+        hs_map->lock_owner = 0;
+        repair_seq();
+        memcpy(hs_map->boot_id, boot, HS_BOOT_ID_LEN);
+        hs_sync(hs_map, sizeof(HsFile));
+    }
+    flock(hs_fd, LOCK_UN);
+
+    // Dono morto neste boot: conserta antes do primeiro hs_top
+    hs_recover();
+    return 0;
+}
+
+void hs_close(void) {
+    if (hs_map) munmap(hs_map, sizeof(HsFile));
+    if (hs_fd >= 0) close(hs_fd);
+    hs_map = NULL;
+    hs_fd = -1;
+}
+
+static HsSong *find_song(uint32_t song_id) {
+    uint32_t count = __atomic_load_n(&hs_map->song_count, __ATOMIC_ACQUIRE);
+    for (uint32_t i = 0; i < count && i < HS_MAX_SONGS; i++) {
+        if (hs_map->songs[i].song_id == song_id) return &hs_map->songs[i];
+    }
+    return NULL;
+}
+
+// Registra uma pontuação. Retorna a posição (0 = primeiro) ou -1 se não
+// entrou no top
+int hs_submit(uint32_t song_id, const char *name, uint32_t score) {
+    if (hs_map == NULL) return -1;
+
+    hs_lock();
+
+    HsSong *song = find_song(song_id);
+    if (song == NULL) {
+        if (hs_map->song_count >= HS_MAX_SONGS) {
+            hs_unlock();
+            return -1;
+        }
+        song = &hs_map->songs[hs_map->song_count];
+        memset(song, 0, sizeof(*song));
+        song->song_id = song_id;
+        hs_sync(song, sizeof(*song));
+        __atomic_store_n(&hs_map->song_count, hs_map->song_count + 1, __ATOMIC_RELEASE);
+        hs_sync(&hs_map->song_count, sizeof(hs_map->song_count));
+    }
+
+    const HsTable *cur = &song->table[song->active];
+    uint32_t next_idx = song->active ^ 1;
+    HsTable *next = &song->table[next_idx];
+
+    int rank = cur->count;
+    for (uint32_t i = 0; i < cur->count; i++) {
+        if (score > cur->entries[i].score) {
+            rank = i;
+            break;
+        }
+    }
+    if (rank >= HS_TOP_N) {
+        hs_unlock();
+        return -1;
+    }
+
+    HsEntry entry = {0};
+    entry.score = score;
+    entry.timestamp = time(NULL);
+    strncpy(entry.name, name, HS_NAME_LEN - 1);
+
+    // Monta a cópia inativa; leitores podem estar nela, daí o seqlock
+    __atomic_fetch_add(&song->seq, 1, __ATOMIC_ACQ_REL);
+    int n = 0;
+    for (int i = 0; i < (int)cur->count && n < HS_TOP_N; i++) {
+        if (i == rank) next->entries[n++] = entry;
+        if (n < HS_TOP_N) next->entries[n++] = cur->entries[i];
+    }
+    if (rank == (int)cur->count && n < HS_TOP_N) next->entries[n++] = entry;
+    next->count = n;
+    hs_sync(next, sizeof(*next));
+
+    // Commit: só depois da cópia estar no disco o índice ativo muda
+    __atomic_store_n(&song->active, next_idx, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&song->seq, 1, __ATOMIC_ACQ_REL);
+    hs_sync(&song->active, sizeof(song->active));
+
+    hs_unlock();
+    return rank;
+}
+
+// Consulta o top da música direto da memória mapeada, sem trava
+int hs_top(uint32_t song_id, HsEntry *out, int max) {
+    if (hs_map == NULL) return 0;
+
+    HsSong *song = find_song(song_id);
+    if (song == NULL) return 0;
+
+    if (max > HS_TOP_N) max = HS_TOP_N;
+    int n;
+    uint32_t seq;
+    int spins = 0;
+    do {
+        seq = __atomic_load_n(&song->seq, __ATOMIC_ACQUIRE);
+        // Ímpar por muito tempo: talvez o escritor tenha morrido no meio;
+        // hs_recover espera um escritor vivo ou conserta
+        if ((seq & 1) && ++spins % HS_READ_SPINS == 0) {
+            hs_recover();
+            seq = __atomic_load_n(&song->seq, __ATOMIC_ACQUIRE);
+        }
+        const HsTable *t = &song->table[__atomic_load_n(&song->active, __ATOMIC_ACQUIRE)];
+        n = t->count < (uint32_t)max ? (int)t->count : max;
+        memcpy(out, t->entries, n * sizeof(HsEntry));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((seq & 1) || seq != __atomic_load_n(&song->seq, __ATOMIC_ACQUIRE));
+
+    return n;
+}
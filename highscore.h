@@ -0,0 +1,63 @@
+#ifndef HIGHSCORE_H
+#define HIGHSCORE_H
+
+#include <stdint.h>
+
+// Placar persistente compartilhado entre os gabinetes do mesmo host.
+// O arquivo tem layout fixo e é usado direto via mmap, sem parsing.
+
+#define HS_DEFAULT_FILE "/var/tmp/guitar_hero_scores.dat"
+#define HS_MAGIC 0x31534847   // "GHS1"
+#define HS_VERSION 1
+#define HS_MAX_SONGS 1024
+#define HS_TOP_N 10
+#define HS_NAME_LEN 16
+#define HS_BOOT_ID_LEN 40
+#define HS_READ_SPINS 1000    // Leituras com seqlock ímpar antes de checar o dono
+
+typedef struct {
+    uint32_t score;
+    uint32_t reserved;
+    int64_t timestamp;        // time(NULL) do registro
+    char name[HS_NAME_LEN];
+} HsEntry;
+
+typedef struct {
+    uint32_t count;
+    uint32_t reserved;
+    HsEntry entries[HS_TOP_N]; // Ordenado do maior para o menor
+} HsTable;
+
+// Cada música tem duas cópias da tabela: o escritor monta a cópia inativa,
+// sincroniza no disco e só então troca o índice ativo. Um processo que
+// morrer no meio do commit deixa a cópia ativa intacta.
+typedef struct {
+    uint32_t song_id;         // 0 = slot livre
+    uint32_t active;          // Índice da cópia válida (0 ou 1)
+    uint32_t seq;             // Seqlock para leitores sem trava; quem toma
+                              // a trava de um dono morto arredonda para par
+    uint32_t reserved;
+    HsTable table[2];
+} HsSong;
+
+// O PID sozinho não identifica o dono da trava: depois de morto ele pode
+// ser reaproveitado. lock_start só vale enquanto lock_owner for o PID em lock
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t lock;            // PID do dono da trava (futex), 0 = livre
+    uint32_t song_count;
+    uint64_t lock_start;      // Início do dono (ticks desde o boot)
+    uint32_t lock_owner;      // PID a que lock_start se refere, 0 = nenhum
+    uint32_t reserved;
+    char boot_id[HS_BOOT_ID_LEN]; // Boot da última abertura; trava de outro boot está morta
+    HsSong songs[HS_MAX_SONGS];
+} HsFile;
+
+uint32_t hs_song_id(const char *title);
+int hs_open(const char *path);
+void hs_close(void);
+int hs_submit(uint32_t song_id, const char *name, uint32_t score);
+int hs_top(uint32_t song_id, HsEntry *out, int max);
+
+#endif
@@ -0,0 +1,332 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "highway.h"
+#include "fb_render.h"
+#include "frame_io.h"
+#include "metrics.h"
+#include "trace.h"
+#include "logger.h"
+#include "rt.h"
+
+static HwScene scene = { .lanes = 4, .peer_score = -1, .power = -1 };
+static const HwBackend *backend = &hw_terminal;
+static int budget = HW_DEFAULT_BUDGET; // Só o terminal tem limite de bytes
+
+void hw_init(int n, int bytes) {
+    scene.lanes = n < 1 ? 1 : (n > HW_MAX_LANES ? HW_MAX_LANES : n);
+    budget = bytes > 0 ? bytes : HW_DEFAULT_BUDGET;
+    hw_invalidate();
+}
+
+// Escolhe o backend pela especificação (ou GH_RENDER):
+//   fb[:dispositivo]       framebuffer, padrão /dev/fb0
+//   ppm:arquivo[:LxA]      imagem em memória, gravada em snapshots
+// Se não der para abrir, fica no terminal
+int hw_open_backend(const char *spec) {
+    if (spec == NULL) spec = getenv("GH_RENDER");
+    if (spec == NULL || strcmp(spec, "term") == 0) return 0;
+
+    char buf[256];
+    strncpy(buf, spec, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+
+    const HwBackend *b = NULL;
+    if (strncmp(buf, "fb", 2) == 0) {
+        b = fb_open(buf[2] == ':' ? buf + 3 : FB_DEFAULT_DEVICE);
+    } else if (strncmp(buf, "ppm:", 4) == 0) {
+        int w = FB_IMAGE_WIDTH, h = FB_IMAGE_HEIGHT;
+        char *size = strrchr(buf + 4, ':');
+        if (size != NULL && sscanf(size + 1, "%dx%d", &w, &h) == 2) *size = '\0';
+        b = fb_open_image(w, h, buf + 4);
+    } else {
+        lg_postf(LG_ERROR, 0, "GH_RENDER desconhecido: %s", spec);
+    }
+
+    if (b == NULL) return -1;
+    backend = b;
+    hw_invalidate();
+    return 0;
+}
+
+void hw_begin(void) {
+    scene.note_count = 0;
+}
+
+void hw_note(int lane, double pos) {
+    if (lane < 0 || lane >= scene.lanes || scene.note_count >= HW_MAX_NOTES) return;
+    scene.notes[scene.note_count].lane = lane;
+    scene.notes[scene.note_count].pos = (float)pos;
+    scene.note_count++;
+}
+
+void hw_hud(int score, int misses, int max_misses) {
+    scene.score = score;
+    scene.misses = misses;
+    scene.max_misses = max_misses;
+}
+
+void hw_peer(int score) {
+    scene.peer_score = score;
+}
+
+void hw_power(int percent, bool active) {
+    scene.power = percent;
+    scene.power_active = active;
+}
+
+// Thread de desenho: com ela o jogo só publica a cena e segue, e quem
+// desenha e escreve (o que pode bloquear num terminal lento ou numa sessão
+// SSH entupida) é ela. Três cenas: a que o jogo preenche, a que a thread
+// desenha e a do meio, com a última publicada. Publicar e pegar são uma
+// troca atômica do índice do meio; uma cena publicada enquanto a thread
+// ainda escrevia é trocada pela seguinte e conta como pulada
+#define HW_FRESH 4            // Bit do índice do meio: cena ainda não pega
+
+static HwScene slots[3];
+static uint32_t middle = 1;
+static int writing = 0;       // Só o jogo mexe
+static uint32_t published = 0; // Futex da thread sem cena nova
+static bool sleeping = false;
+static bool stopping = false;
+static bool threaded = false;
+static pthread_t thread;
+
+static void futex_wait(uint32_t *addr, uint32_t val) {
+    syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+static void futex_wake(uint32_t *addr) {
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+// Só acorda a thread se ela estiver dormindo: com ela ocupada escrevendo,
+// publicar não custa syscall
+static void wake_drawer(void) {
+    __atomic_add_fetch(&published, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&sleeping, __ATOMIC_SEQ_CST)) futex_wake(&published);
+}
+
+static void publish(void) {
+    slots[writing] = scene;
+    uint32_t old = __atomic_exchange_n(&middle, (uint32_t)writing | HW_FRESH, __ATOMIC_ACQ_REL);
+    if (old & HW_FRESH) mt_add(MT_FRAMES_SKIPPED, 1);
+    writing = old & 3;
+    wake_drawer();
+}
+
+static void *draw_thread(void *arg) {
+    (void)arg;
+    rt_background_thread();
+    tr_thread("desenho");
+    uint32_t reading = 2;
+
+    while (!__atomic_load_n(&stopping, __ATOMIC_ACQUIRE)) {
+        uint32_t seen = __atomic_load_n(&published, __ATOMIC_SEQ_CST);
+        if (!(__atomic_load_n(&middle, __ATOMIC_SEQ_CST) & HW_FRESH)) {
+            // Marca que vai dormir e olha de novo: o jogo que publicar
+            // depois disso vê a marca e acorda, e o que publicou antes
+            // mudou published, então o futex_wait volta na hora
+            __atomic_store_n(&sleeping, true, __ATOMIC_SEQ_CST);
+            if (!(__atomic_load_n(&middle, __ATOMIC_SEQ_CST) & HW_FRESH) &&
+                !__atomic_load_n(&stopping, __ATOMIC_SEQ_CST)) {
+                futex_wait(&published, seen);
+            }
+            __atomic_store_n(&sleeping, false, __ATOMIC_SEQ_CST);
+            continue;
+        }
+        reading = __atomic_exchange_n(&middle, reading, __ATOMIC_ACQ_REL) & 3;
+
+        tr_begin("desenho");
+        backend->flush(&slots[reading]);
+        fio_frame(0);
+        tr_end("desenho");
+        mt_add(MT_FRAMES_DRAWN, 1);
+    }
+    return NULL;
+}
+
+// Passa o desenho e a saída (fio_*) para a thread até hw_stop_thread.
+// Nesse meio tempo o jogo não escreve no terminal nem invalida a pista.
+// Retorna false se a thread não subiu; aí hw_flush continua desenhando
+bool hw_start_thread(void) {
+    if (threaded) return true;
+    middle = 1;
+    writing = 0;
+    stopping = false;
+    int err = pthread_create(&thread, NULL, draw_thread, NULL);
+    if (err) {
+        lg_post(LG_WARN, err, "Thread de desenho indisponivel, desenhando no jogo");
+        return false;
+    }
+    threaded = true;
+    return true;
+}
+
+// Espera a thread terminar a escrita em curso; a última cena publicada
+// pode ficar sem desenhar (quem para costuma redesenhar a tela logo depois)
+void hw_stop_thread(void) {
+    if (!threaded) return;
+    __atomic_store_n(&stopping, true, __ATOMIC_SEQ_CST);
+    wake_drawer();
+    pthread_join(thread, NULL);
+    threaded = false;
+}
+
+// Sem a thread desenha na hora; com ela só publica
+int hw_flush(void) {
+    if (threaded) {
+        publish();
+        return 0;
+    }
+    return backend->flush(&scene);
+}
+
+// Depois de limpar a tela, tudo precisa ser redesenhado
+void hw_invalidate(void) {
+    backend->invalidate();
+}
+
+// Grava a imagem atual, nos backends que têm uma
+void hw_snapshot(void) {
+    if (backend->snapshot) backend->snapshot();
+}
+
+void hw_close(void) {
+    if (backend->close) backend->close();
+    backend = &hw_terminal;
+}
+
+// Linha do terminal logo abaixo da pista, para mensagens
+int hw_hud_row(void) {
+    return HW_ROWS + 2;
+}
+
+// Backend de terminal
+
+// Conteúdo de uma célula (uma pista numa linha)
+enum {
+    CELL_EMPTY,
+    CELL_UPPER,               // Nota na sub-linha de cima
+    CELL_LOWER,               // Nota na sub-linha de baixo
+    CELL_FULL,                // Duas notas, uma em cada sub-linha
+    CELL_STRIKE,              // Linha de batida sem nota
+    CELL_UNKNOWN = 0xFF       // Terminal com conteúdo desconhecido
+};
+
+static const char *glyphs[] = {
+    " . ", "▀▀▀", "▄▄▄", "███", "==="
+};
+
+static const char *lane_colors[HW_MAX_LANES] = {
+    "\033[32m", "\033[31m", "\033[33m", "\033[34m",
+    "\033[35m", "\033[36m", "\033[37m", "\033[91m"
+};
+
+static unsigned char want[HW_ROWS + 1][HW_MAX_LANES];
+static unsigned char shown[HW_ROWS + 1][HW_MAX_LANES];
+static char last_hud[64];
+
+static void term_invalidate(void) {
+    memset(shown, CELL_UNKNOWN, sizeof(shown));
+    last_hud[0] = '\0';
+}
+
+// Notas um pouco além da linha ainda aparecem nela enquanto podem ser
+// acertadas
+static void term_place(int lane, double pos) {
+    if (pos < 0) return;
+
+    int sub = (int)(pos * HW_ROWS * 2);
+    int row = sub / 2;
+    if (row > HW_ROWS) return;
+
+    unsigned char half = (sub & 1) ? CELL_LOWER : CELL_UPPER;
+    unsigned char *cell = &want[row][lane];
+    if (*cell == CELL_EMPTY || *cell == CELL_STRIKE) *cell = half;
+    else if (*cell != half) *cell = CELL_FULL;
+}
+
+// Envia as diferenças. Retorna quantos bytes foram gerados
+static int term_flush(const HwScene *sc) {
+    memset(want, CELL_EMPTY, sizeof(want));
+    for (int lane = 0; lane < sc->lanes; lane++) want[HW_ROWS][lane] = CELL_STRIKE;
+    for (int i = 0; i < sc->note_count; i++) term_place(sc->notes[i].lane, sc->notes[i].pos);
+
+    // Placar só é reenviado quando muda. Os bytes dele saem do orçamento
+    // antes das células; se nem ele couber, fica para o próximo quadro
+    char hud[sizeof(last_hud)];
+    int n = snprintf(hud, sizeof(hud), "Score: %d | Erros: %d/%d", sc->score, sc->misses, sc->max_misses);
+    if (sc->peer_score >= 0 && n < (int)sizeof(hud)) {
+        n += snprintf(hud + n, sizeof(hud) - n, " | Adversario: %d", sc->peer_score);
+    }
+    if (sc->power >= 0 && n < (int)sizeof(hud)) {
+        snprintf(hud + n, sizeof(hud) - n, " | Energia: %d%%%s", sc->power, sc->power_active ? " x2" : "");
+    }
+    char line[sizeof(hud) + 16];
+    int hud_len = 0;
+    if (strcmp(hud, last_hud) != 0) {
+        hud_len = snprintf(line, sizeof(line), "\033[%d;1H%s\033[K", hw_hud_row(), hud);
+        if (hud_len > budget) hud_len = 0;
+    }
+    int cells_budget = budget - hud_len;
+
+    char buf[64];
+    int used = 0;
+    int cur_row = -1, cur_col = -1;
+    int cur_lane_color = -1;
+
+    for (int row = HW_ROWS; row >= 0; row--) {
+        for (int lane = 0; lane < sc->lanes; lane++) {
+            unsigned char c = want[row][lane];
+            if (c == shown[row][lane]) continue;
+
+            int col = lane * (HW_LANE_WIDTH + 1) + 1;
+            int len = 0;
+            if (row == cur_row && col == cur_col + 1) {
+                // Pista vizinha: um espaço sai mais barato que mover o cursor
+                buf[len++] = ' ';
+            } else if (row != cur_row || col != cur_col) {
+                len += snprintf(buf + len, sizeof(buf) - len, "\033[%d;%dH", row + 1, col);
+            }
+            if (lane != cur_lane_color) {
+                len += snprintf(buf + len, sizeof(buf) - len, "%s", lane_colors[lane]);
+            }
+            len += snprintf(buf + len, sizeof(buf) - len, "%s", glyphs[c]);
+
+            // Reserva o "\033[0m" final
+            if (used + len + 4 > cells_budget) goto out;
+
+            buf[len] = '\0';
+            fio_printf("%s", buf);
+            used += len;
+            shown[row][lane] = c;
+            cur_row = row;
+            cur_col = col + HW_LANE_WIDTH;
+            cur_lane_color = lane;
+        }
+    }
+out:
+    if (cur_lane_color >= 0) {
+        fio_printf("\033[0m");
+        used += 4;
+    }
+
+    if (hud_len > 0) {
+        fio_printf("%s", line);
+        used += hud_len;
+        strcpy(last_hud, hud);
+    }
+    return used;
+}
+
+const HwBackend hw_terminal = {
+    .flush = term_flush,
+    .invalidate = term_invalidate,
+};
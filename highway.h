@@ -0,0 +1,66 @@
+#ifndef HIGHWAY_H
+#define HIGHWAY_H
+
+#include <stdbool.h>
+
+// Pista de notas. O jogo descreve a cena de cada quadro (notas e placar)
+// e o backend escolhido desenha só o que mudou:
+//
+// terminal     células de texto por diferença, das mais próximas da linha
+//              de batida para cima, até esgotar o orçamento de bytes do
+//              quadro; o que sobrar sai no quadro seguinte. Cada linha tem
+//              duas sub-linhas, desenhadas com meio-bloco (▀ ▄)
+// framebuffer  rasterizador em /dev/fb0 ou numa imagem em memória que
+//              pode ser gravada como PPM (fb_render.c)
+//
+// Durante a música o desenho roda numa thread própria (hw_start_thread):
+// hw_flush só publica a cena, e um terminal lento atrasa a tela, não o jogo.
+
+#define HW_MAX_LANES 8
+#define HW_MAX_NOTES 128
+#define HW_ROWS 20            // Linhas da pista acima da linha de batida
+#define HW_LANE_WIDTH 3       // Colunas por pista (mais 1 de separação)
+#define HW_DEFAULT_BUDGET 2048 // Bytes por quadro (GH_BYTE_BUDGET)
+
+typedef struct {
+    int lane;
+    float pos;                // 0 = topo da pista, 1 = linha de batida
+} HwNote;
+
+typedef struct {
+    int lanes;
+    HwNote notes[HW_MAX_NOTES];
+    int note_count;
+    int score;
+    int misses;
+    int max_misses;
+    int peer_score;           // Adversário no versus, -1 sem
+    int power;                // Energia em %, -1 sem joystick
+    bool power_active;        // Bônus ligado
+} HwScene;
+
+typedef struct {
+    int (*flush)(const HwScene *scene);
+    void (*invalidate)(void);
+    void (*snapshot)(void);
+    void (*close)(void);
+} HwBackend;
+
+extern const HwBackend hw_terminal;
+
+void hw_init(int lanes, int budget);
+int hw_open_backend(const char *spec);
+void hw_begin(void);
+void hw_note(int lane, double pos);
+void hw_hud(int score, int misses, int max_misses);
+void hw_peer(int score);
+void hw_power(int percent, bool active);
+int hw_flush(void);
+bool hw_start_thread(void);
+void hw_stop_thread(void);
+void hw_invalidate(void);
+void hw_snapshot(void);
+void hw_close(void);
+int hw_hud_row(void);
+
+#endif
@@ -1,6 +1,8 @@
 #include <stdio.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <poll.h>
+#include <errno.h>
 #include <linux/joystick.h>
 
 int main() {
@@ -21,8 +23,21 @@ int main() {
     printf("Pressione os botões para testar...\n");
 
     struct js_event e;
+    struct pollfd pfd = { .fd = joy_fd, .events = POLLIN };
     while (1) {
-        while (read(joy_fd, &e, sizeof(e)) > 0) {
+        // Dorme até o joystick ter eventos, sem acordar periodicamente
+        if (poll(&pfd, 1, -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("Erro no poll do joystick");
+            break;
+        }
+        // Desconectado: POLLHUP/POLLERR voltariam na hora para sempre
+        if (pfd.revents & (POLLHUP | POLLERR | POLLNVAL)) {
+            printf("Joystick desconectado\n");
+            break;
+        }
+        ssize_t n;
+        while ((n = read(joy_fd, &e, sizeof(e))) > 0) {
             if (e.type == JS_EVENT_BUTTON && e.value == 1) {
                 if (e.number == botoes.botao1) {
                     printf("Botão 1 pressionado!\n");
@@ -42,7 +57,10 @@ int main() {
                 }
             }
         }
-        usleep(10000); // Pequena pausa
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+            printf("Joystick desconectado\n");
+            break;
+        }
     }
     
     close(joy_fd);
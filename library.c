@@ -0,0 +1,402 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <string.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "library.h"
+#include "logger.h"
+
+static LibIndex *lib_map = NULL;
+static size_t lib_map_len = 0;
+static bool lib_mapped = false;   // false = montado em memória (malloc)
+
+// Partitura encontrada no diretório
+typedef struct {
+    char file[LIB_PATH_LEN];
+    int64_t mtime_ns;
+    uint64_t size;
+    const LibEntry *reused;       // Entradas ainda válidas do índice antigo
+    LibEntry *parsed;             // Ou lidas agora (malloc)
+    int count;
+    bool failed;                  // Não abriu (agora ou quando foi indexada)
+} Scan;
+
+typedef struct {
+    const char *root;
+    Scan *scans;
+    int *stale;
+    int stale_count;
+    int next;
+} ParseJob;
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static uint32_t fnv(uint32_t h, const void *data, size_t len) {
+    const unsigned char *p = data;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static uint32_t checksum(const char *path) {
+    uint32_t h = 2166136261u;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        const unsigned char *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            h = fnv(h, p, st.st_size);
+            munmap((void *)p, st.st_size);
+        }
+    }
+    close(fd);
+    return h;
+}
+
+// Checksum do índice: root e todas as entradas, inclusive as com falha
+static uint32_t index_sum(const LibIndex *idx) {
+    uint32_t h = fnv(2166136261u, idx->root, LIB_PATH_LEN);
+    return fnv(h, idx->entries, ((size_t)idx->count + idx->failed) * sizeof(LibEntry));
+}
+
+// Lê uma partitura e monta uma entrada por nível
+static void parse_file(const char *root, Scan *scan) {
+    char path[LIB_PATH_LEN * 2];
+    snprintf(path, sizeof(path), "%s/%s", root, scan->file);
+
+    // Falha fica registrada no índice: o arquivo só é relido se mudar
+    Chart chart;
+    if (chart_load(path, &chart, NULL) < 0) {
+        scan->failed = true;
+        return;
+    }
+    if (chart.level_count == 0) {
+        lg_postf(LG_WARN, 0, "%s: partitura sem niveis", path);
+        scan->failed = true;
+        chart_free(&chart);
+        return;
+    }
+
+    scan->parsed = calloc(chart.level_count, sizeof(LibEntry));
+    if (scan->parsed == NULL) {
+        chart_free(&chart);
+        return;
+    }
+
+    uint32_t sum = checksum(path);
+    for (int i = 0; i < chart.level_count; i++) {
+        const ChartLevel *level = &chart.levels[i];
+        LibEntry *e = &scan->parsed[i];
+        memcpy(e->file, scan->file, LIB_PATH_LEN);
+        memcpy(e->title, chart.title, CHART_TITLE_LEN);
+        memcpy(e->level, level->name, CHART_LEVEL_LEN);
+        e->mtime_ns = scan->mtime_ns;
+        e->size = scan->size;
+        e->chart_offset = level->offset;
+        e->checksum = sum;
+        e->note_count = level->count;
+        e->duration_ms = level->count ? level->notes[level->count - 1].time_ms : 0;
+        e->level_index = i;
+        e->lanes = chart.lanes;
+        e->bpm = chart.bpm;
+    }
+    scan->count = chart.level_count;
+    chart_free(&chart);
+}
+
+static void *parse_worker(void *arg) {
+    ParseJob *job = arg;
+    for (;;) {
+        int i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+        if (i >= job->stale_count) return NULL;
+        parse_file(job->root, &job->scans[job->stale[i]]);
+    }
+}
+
+// Mapeia o índice gravado; NULL se não existe, não é deste diretório ou
+// não confere com o checksum (aí ele é refeito)
+static LibIndex *map_index(const char *path, const char *root, size_t *len) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    LibIndex *idx = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(LibIndex)) {
+        idx = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (idx == MAP_FAILED) return NULL;
+
+    if (idx->magic != LIB_MAGIC || idx->version != LIB_VERSION ||
+        sizeof(LibIndex) + ((size_t)idx->count + idx->failed) * sizeof(LibEntry) > (size_t)st.st_size ||
+        strncmp(idx->root, root, LIB_PATH_LEN) != 0) {
+        munmap(idx, st.st_size);
+        return NULL;
+    }
+    if (index_sum(idx) != idx->checksum) {
+        lg_postf(LG_WARN, 0, "%s: checksum do indice nao confere, refazendo", path);
+        munmap(idx, st.st_size);
+        return NULL;
+    }
+    *len = st.st_size;
+    return idx;
+}
+
+static int by_file(const void *a, const void *b) {
+    return strcmp(((const Scan *)a)->file, ((const Scan *)b)->file);
+}
+
+// Primeira entrada do arquivo numa parte do índice antigo (ordenada por
+// arquivo)
+static const LibEntry *find_file(const LibEntry *entries, int total, const char *file, int *count) {
+    int lo = 0, hi = total;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (strcmp(entries[mid].file, file) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    int n = 0;
+    while (lo + n < total && strcmp(entries[lo + n].file, file) == 0) n++;
+    *count = n;
+    return n ? &entries[lo] : NULL;
+}
+
+// Grava o índice num temporário e troca com rename: quem já mapeou o
+// antigo continua lendo uma versão inteira
+static int save_index(const char *path, const LibIndex *idx, size_t len) {
+    char tmp[PATH_MAX];
+    snprintf(tmp, sizeof(tmp), "%s.tmp.%d", path, (int)getpid());
+
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+        lg_postf(LG_ERROR, errno, "Falha ao gravar indice da biblioteca %s", path);
+        return -1;
+    }
+    const char *p = (const char *)idx;
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = write(fd, p + done, len - done);
+        if (n <= 0) break;
+        done += n;
+    }
+    if (done < len || fsync(fd) < 0 || close(fd) < 0 || rename(tmp, path) < 0) {
+        lg_postf(LG_ERROR, errno, "Falha ao gravar indice da biblioteca %s", path);
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+// Abre a biblioteca do diretório dir, atualizando o índice se preciso
+int lib_open(const char *dir, const char *index_path, LibStats *stats) {
+    double start = now_ms();
+    memset(stats, 0, sizeof(*stats));
+    if (index_path == NULL) {
+        index_path = getenv("GH_LIBRARY_INDEX");
+        if (index_path == NULL) index_path = LIB_DEFAULT_INDEX;
+    }
+
+    // realpath pode devolver até PATH_MAX; o índice guarda LIB_PATH_LEN
+    char root[LIB_PATH_LEN] = {0};
+    char *real = realpath(dir, NULL);
+    if (real == NULL) {
+        lg_postf(LG_ERROR, errno, "Falha ao abrir biblioteca %s", dir);
+        return -1;
+    }
+    if (strlen(real) >= LIB_PATH_LEN) {
+        lg_postf(LG_ERROR, 0, "%s: caminho da biblioteca longo demais", real);
+        free(real);
+        return -1;
+    }
+    strcpy(root, real);
+    free(real);
+
+    DIR *d = opendir(root);
+    if (d == NULL) {
+        lg_postf(LG_ERROR, errno, "Falha ao abrir biblioteca %s", root);
+        return -1;
+    }
+
+    Scan *scans = NULL;
+    int count = 0, capacity = 0;
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+        size_t name_len = strlen(de->d_name);
+        size_t ext_len = strlen(CHART_EXT);
+        if (name_len <= ext_len || name_len >= LIB_PATH_LEN ||
+            strcmp(de->d_name + name_len - ext_len, CHART_EXT) != 0) {
+            continue;
+        }
+
+        struct stat st;
+        if (fstatat(dirfd(d), de->d_name, &st, 0) < 0 || !S_ISREG(st.st_mode)) continue;
+
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            Scan *grown = realloc(scans, capacity * sizeof(Scan));
+            if (grown == NULL) break;
+            scans = grown;
+        }
+        Scan *s = &scans[count++];
+        memset(s, 0, sizeof(*s));
+        memcpy(s->file, de->d_name, name_len + 1);
+        s->mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+        s->size = st.st_size;
+    }
+    closedir(d);
+    qsort(scans, count, sizeof(Scan), by_file);
+
+    // Reaproveita o que não mudou
+    size_t old_len = 0;
+    LibIndex *old = map_index(index_path, root, &old_len);
+    int *stale = malloc((count ? count : 1) * sizeof(int));
+    int stale_count = 0, reused_entries = 0, reused_failed = 0;
+    for (int i = 0; i < count; i++) {
+        int n = 0;
+        bool failed = false;
+        const LibEntry *e = NULL;
+        if (old != NULL) {
+            e = find_file(old->entries, old->count, scans[i].file, &n);
+            if (e == NULL) {
+                e = find_file(old->entries + old->count, old->failed, scans[i].file, &n);
+                failed = e != NULL;
+            }
+        }
+        if (e != NULL && e->mtime_ns == scans[i].mtime_ns && e->size == scans[i].size) {
+            if (failed) {
+                scans[i].failed = true;
+                reused_failed++;
+            } else {
+                scans[i].reused = e;
+                scans[i].count = n;
+                reused_entries += n;
+            }
+        } else {
+            stale[stale_count++] = i;
+        }
+    }
+
+    bool unchanged = old != NULL && stale_count == 0 && reused_entries == (int)old->count &&
+                     reused_failed == (int)old->failed;
+    if (unchanged) {
+        lib_map = old;
+        lib_map_len = old_len;
+        lib_mapped = true;
+    } else {
+        if (stale_count > 0) {
+            ParseJob job = { root, scans, stale, stale_count, 0 };
+            int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+            if (threads > stale_count) threads = stale_count;
+            if (threads > LIB_MAX_THREADS) threads = LIB_MAX_THREADS;
+            if (threads < 1) threads = 1;
+
+            pthread_t tids[LIB_MAX_THREADS];
+            int started = 0;
+            for (; started < threads; started++) {
+                int err = pthread_create(&tids[started], NULL, parse_worker, &job);
+                if (err) {
+                    lg_post(LG_WARN, err, "Thread de leitura indisponivel");
+                    break;
+                }
+            }
+            // Faltou thread: esta mesma lê o que sobrar, em série se preciso
+            if (started < threads) parse_worker(&job);
+            for (int t = 0; t < started; t++) pthread_join(tids[t], NULL);
+        }
+
+        int total = 0, failed = 0;
+        for (int i = 0; i < count; i++) {
+            total += scans[i].count;
+            failed += scans[i].failed;
+        }
+
+        size_t len = sizeof(LibIndex) + ((size_t)total + failed) * sizeof(LibEntry);
+        LibIndex *idx = calloc(1, len);
+        if (idx != NULL) {
+            idx->magic = LIB_MAGIC;
+            idx->version = LIB_VERSION;
+            idx->count = total;
+            idx->failed = failed;
+            memcpy(idx->root, root, LIB_PATH_LEN);
+            int n = 0, f = total;
+            for (int i = 0; i < count; i++) {
+                if (scans[i].failed) {
+                    LibEntry *e = &idx->entries[f++];
+                    memcpy(e->file, scans[i].file, LIB_PATH_LEN);
+                    e->mtime_ns = scans[i].mtime_ns;
+                    e->size = scans[i].size;
+                    continue;
+                }
+                const LibEntry *src = scans[i].reused ? scans[i].reused : scans[i].parsed;
+                if (scans[i].count > 0) memcpy(&idx->entries[n], src, scans[i].count * sizeof(LibEntry));
+                n += scans[i].count;
+            }
+            idx->checksum = index_sum(idx);
+        }
+        if (old != NULL) munmap(old, old_len);
+
+        // O jogo usa o índice gravado pelo mmap, como no caminho sem
+        // mudanças; sem conseguir gravar, fica com a cópia em memória
+        LibIndex *saved = NULL;
+        if (idx != NULL && save_index(index_path, idx, len) == 0) saved = map_index(index_path, root, &lib_map_len);
+        if (saved != NULL) {
+            free(idx);
+            lib_map = saved;
+            lib_mapped = true;
+        } else {
+            lib_map = idx;
+            lib_map_len = len;
+            lib_mapped = false;
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        stats->failed += scans[i].failed;
+        free(scans[i].parsed);
+    }
+    free(scans);
+    free(stale);
+
+    stats->files = count;
+    stats->parsed = stale_count;
+    stats->elapsed_ms = now_ms() - start;
+    return lib_map ? 0 : -1;
+}
+
+void lib_close(void) {
+    if (lib_map != NULL) {
+        if (lib_mapped) munmap(lib_map, lib_map_len);
+        else free(lib_map);
+    }
+    lib_map = NULL;
+    lib_map_len = 0;
+}
+
+int lib_count(void) {
+    return lib_map ? (int)lib_map->count : 0;
+}
+
+const LibEntry *lib_entry(int i) {
+    return &lib_map->entries[i];
+}
+
+int lib_path(const LibEntry *entry, char *out, size_t size) {
+    int n = snprintf(out, size, "%s/%s", lib_map->root, entry->file);
+    return n < (int)size ? 0 : -1;
+}
@@ -0,0 +1,63 @@
+#ifndef LIBRARY_H
+#define LIBRARY_H
+
+#include <stdint.h>
+
+#include "chart.h"
+
+// Biblioteca de músicas: índice persistente das partituras de um diretório
+// (GH_LIBRARY), usado direto via mmap. Na abertura só os arquivos novos ou
+// com mtime/tamanho diferentes são lidos de novo, em paralelo; o índice
+// novo é gravado num temporário e trocado com rename. Partituras que não
+// abrem ficam registradas (com mtime e tamanho) para não serem relidas a
+// cada abertura enquanto não mudarem.
+
+#define LIB_DEFAULT_INDEX "/var/tmp/guitar_hero_library.dat"
+#define LIB_MAGIC 0x31424C47  // "GLB1"
+#define LIB_VERSION 2         // v2: partituras com falha e checksum do índice
+#define LIB_PATH_LEN 256
+#define LIB_MAX_THREADS 64
+
+// Uma entrada por nível de cada partitura
+typedef struct {
+    char file[LIB_PATH_LEN];  // Relativo ao diretório da biblioteca
+    char title[CHART_TITLE_LEN];
+    char level[CHART_LEVEL_LEN];
+    int64_t mtime_ns;
+    uint64_t size;
+    uint64_t chart_offset;    // Posição da primeira nota do nível no arquivo
+    uint32_t checksum;        // FNV-1a do arquivo inteiro
+    uint32_t note_count;
+    uint32_t duration_ms;     // Tempo da última nota
+    uint32_t level_index;
+    uint32_t lanes;
+    float bpm;
+} LibEntry;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t failed;          // Partituras que não abriram, depois das entradas
+    uint32_t checksum;        // FNV-1a de root e de todas as entradas
+    uint32_t reserved;
+    char root[LIB_PATH_LEN];  // Diretório indexado
+    LibEntry entries[];       // count ordenadas por arquivo e nível, depois
+                              // failed ordenadas por arquivo (só file,
+                              // mtime_ns e size valem)
+} LibIndex;
+
+typedef struct {
+    int files;
+    int parsed;               // Arquivos lidos de novo nesta abertura
+    int failed;               // Partituras que não abriram
+    double elapsed_ms;
+} LibStats;
+
+int lib_open(const char *dir, const char *index_path, LibStats *stats);
+void lib_close(void);
+int lib_count(void);
+const LibEntry *lib_entry(int i);
+int lib_path(const LibEntry *entry, char *out, size_t size);
+
+#endif
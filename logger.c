@@ -0,0 +1,378 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <syslog.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "logger.h"
+
+// Tipo de cada conversão do formato adiado, para ler e repassar o
+// argumento exatamente como o chamador passou (int, long, ponteiro...)
+typedef enum {
+    ARG_INT,
+    ARG_UINT,
+    ARG_LONG,
+    ARG_ULONG,
+    ARG_LLONG,
+    ARG_ULLONG,
+    ARG_PTR
+} ArgType;
+
+typedef union {
+    long long i;
+    unsigned long long u;
+    const void *p;
+} LgArg;
+
+// Registro da fila. seq segue o esquema de Vyukov: igual à posição quando
+// livre para o produtor, posição + 1 quando pronto para o consumidor
+typedef struct {
+    uint64_t seq;
+    int64_t time_ns;          // CLOCK_REALTIME
+    const char *fmt;          // Também a chave do limite de taxa
+    union {
+        LgArg args[LG_MAX_ARGS];
+        char text[LG_TEXT];   // Com formatted: mensagem pronta
+    };
+    int err;
+    int level;
+    bool formatted;
+} LgRecord;
+
+// Limite de taxa por ponto de chamada (o ponteiro do formato)
+typedef struct {
+    const char *fmt;
+    int64_t window_s;
+    unsigned count;
+    unsigned long suppressed;
+} LgSite;
+
+static LgRecord ring[LG_RING];
+static uint64_t head = 0;         // Próxima posição dos produtores
+static uint64_t tail = 0;         // Só a thread de fundo mexe
+static unsigned long dropped = 0;
+static bool running = false;
+static bool stopping = false;
+static pthread_t thread;
+static FILE *out = NULL;
+static bool use_syslog = false;
+static LgSite sites[LG_SITES];
+
+// A thread de fundo dorme no futex com a fila vazia; o produtor só faz a
+// syscall se ela estiver dormindo
+static uint32_t posted = 0;
+static bool sleeping = false;
+
+static const char *level_names[] = { "DEBUG", "INFO", "AVISO", "ERRO" };
+static const int syslog_levels[] = { LOG_DEBUG, LOG_INFO, LOG_WARNING, LOG_ERR };
+
+static int64_t wall_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void futex_wait(uint32_t *addr, uint32_t val) {
+    syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+static void futex_wake(uint32_t *addr) {
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+static void wake_consumer(void) {
+    __atomic_add_fetch(&posted, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&sleeping, __ATOMIC_SEQ_CST)) futex_wake(&posted);
+}
+
+// Próxima conversão do formato a partir de p (flags, largura, precisão e
+// h, l, ll, z; sem '*'). Retorna o '%' dela, ou NULL; *end fica logo depois
+static const char *next_conv(const char *p, const char **end, ArgType *type) {
+    for (; *p; p++) {
+        if (*p != '%') continue;
+        if (p[1] == '%') {
+            p++;
+            continue;
+        }
+        const char *q = p + 1 + strspn(p + 1, "-+ #0123456789.");
+        int longs = 0;
+        bool size = false;
+        while (*q == 'h') q++;
+        while (*q == 'l') {
+            longs++;
+            q++;
+        }
+        if (*q == 'z') {
+            size = true;
+            q++;
+        }
+        bool is_signed = *q == 'd' || *q == 'i';
+        if (*q == 's' || *q == 'p') *type = ARG_PTR;
+        else if (size || longs == 1) *type = is_signed ? ARG_LONG : ARG_ULONG;
+        else if (longs >= 2) *type = is_signed ? ARG_LLONG : ARG_ULLONG;
+        else *type = is_signed || *q == 'c' ? ARG_INT : ARG_UINT;
+        *end = *q ? q + 1 : q;
+        return p;
+    }
+    return NULL;
+}
+
+static void fill(LgRecord *r, LgLevel level, int err, bool now, const char *fmt, va_list ap) {
+    r->time_ns = wall_ns();
+    r->fmt = fmt;
+    r->err = err;
+    r->level = level;
+    r->formatted = now;
+    if (now) {
+        vsnprintf(r->text, LG_TEXT, fmt, ap);
+        return;
+    }
+    memset(r->args, 0, sizeof(r->args));
+    const char *p = fmt, *end;
+    ArgType type;
+    for (int i = 0; i < LG_MAX_ARGS && (p = next_conv(p, &end, &type)) != NULL; i++, p = end) {
+        switch (type) {
+        case ARG_INT:    r->args[i].i = va_arg(ap, int); break;
+        case ARG_UINT:   r->args[i].u = va_arg(ap, unsigned); break;
+        case ARG_LONG:   r->args[i].i = va_arg(ap, long); break;
+        case ARG_ULONG:  r->args[i].u = va_arg(ap, unsigned long); break;
+        case ARG_LLONG:  r->args[i].i = va_arg(ap, long long); break;
+        case ARG_ULLONG: r->args[i].u = va_arg(ap, unsigned long long); break;
+        case ARG_PTR:    r->args[i].p = va_arg(ap, const void *); break;
+        }
+    }
+}
+
+// Formata um registro adiado: o texto fixo é copiado, e cada conversão é
+// formatada sozinha com o tipo original do argumento
+static int format_args(char *msg, size_t size, const LgRecord *r) {
+    size_t len = 0;
+    const char *p = r->fmt, *conv, *end;
+    ArgType type;
+    for (int i = 0; len < size; i++) {
+        conv = i < LG_MAX_ARGS ? next_conv(p, &end, &type) : NULL;
+        // Texto até a conversão (ou até o fim), com %% virando %
+        const char *stop = conv ? conv : p + strlen(p);
+        while (p < stop && len + 1 < size) {
+            if (p[0] == '%' && p[1] == '%') p++;
+            msg[len++] = *p++;
+        }
+        msg[len] = '\0';
+        if (conv == NULL || len + 1 >= size) break;
+
+        char spec[16];
+        snprintf(spec, sizeof(spec), "%.*s", (int)(end - conv), conv);
+        const LgArg *a = &r->args[i];
+        int n = 0;
+        switch (type) {
+        case ARG_INT:    n = snprintf(msg + len, size - len, spec, (int)a->i); break;
+        case ARG_UINT:   n = snprintf(msg + len, size - len, spec, (unsigned)a->u); break;
+        case ARG_LONG:   n = snprintf(msg + len, size - len, spec, (long)a->i); break;
+        case ARG_ULONG:  n = snprintf(msg + len, size - len, spec, (unsigned long)a->u); break;
+        case ARG_LLONG:  n = snprintf(msg + len, size - len, spec, a->i); break;
+        case ARG_ULLONG: n = snprintf(msg + len, size - len, spec, a->u); break;
+        case ARG_PTR:    n = snprintf(msg + len, size - len, spec, a->p); break;
+        }
+        if (n < 0) break;
+        len += (size_t)n < size - len ? (size_t)n : size - len - 1;
+        p = end;
+    }
+    return (int)len;
+}
+
+static void emit_line(int level, int64_t time_ns, const char *msg) {
+    if (use_syslog) {
+        syslog(syslog_levels[level], "%s", msg);
+        return;
+    }
+
+    time_t sec = time_ns / 1000000000;
+    struct tm tm;
+    char stamp[32];
+    localtime_r(&sec, &tm);
+    strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &tm);
+    FILE *f = out ? out : stderr;
+    fprintf(f, "%s.%03d %s %s\n", stamp, (int)(time_ns / 1000000 % 1000), level_names[level], msg);
+}
+
+static void emit(const LgRecord *r) {
+    char msg[256];
+    int len = r->formatted ? snprintf(msg, sizeof(msg), "%s", r->text) : format_args(msg, sizeof(msg), r);
+    if (r->err && len >= 0 && len < (int)sizeof(msg)) {
+        snprintf(msg + len, sizeof(msg) - len, ": %s", strerror(r->err));
+    }
+    emit_line(r->level, r->time_ns, msg);
+}
+
+static LgSite *find_site(const char *fmt) {
+    unsigned h = (unsigned)((uintptr_t)fmt >> 3) % LG_SITES;
+    for (int i = 0; i < LG_SITES; i++) {
+        LgSite *s = &sites[(h + i) % LG_SITES];
+        if (s->fmt == fmt || s->fmt == NULL) {
+            s->fmt = fmt;
+            return s;
+        }
+    }
+    return NULL;              // Tabela cheia: sem limite para este
+}
+
+static void report_suppressed(LgSite *s, int64_t time_ns) {
+    if (s->suppressed == 0) return;
+    char msg[256];
+    snprintf(msg, sizeof(msg), "%lu mensagens suprimidas: \"%s\"", s->suppressed, s->fmt);
+    emit_line(LG_WARN, time_ns, msg);
+    s->suppressed = 0;
+}
+
+static void consume(const LgRecord *r) {
+    LgSite *s = find_site(r->fmt);
+    if (s != NULL) {
+        int64_t window = r->time_ns / 1000000000;
+        if (window != s->window_s) {
+            report_suppressed(s, r->time_ns);
+            s->window_s = window;
+            s->count = 0;
+        }
+        if (++s->count > LG_RATE) {
+            s->suppressed++;
+            return;
+        }
+    }
+    emit(r);
+}
+
+static void *lg_thread(void *arg) {
+    (void)arg;
+    unsigned long reported_drops = 0;
+
+    for (;;) {
+        uint32_t seen = __atomic_load_n(&posted, __ATOMIC_SEQ_CST);
+        LgRecord *r = &ring[tail & (LG_RING - 1)];
+        if (__atomic_load_n(&r->seq, __ATOMIC_ACQUIRE) == tail + 1) {
+            consume(r);
+            __atomic_store_n(&r->seq, tail + LG_RING, __ATOMIC_RELEASE);
+            tail++;
+            continue;
+        }
+
+        unsigned long drops = __atomic_load_n(&dropped, __ATOMIC_RELAXED);
+        if (drops != reported_drops) {
+            char msg[64];
+            snprintf(msg, sizeof(msg), "%lu mensagens perdidas (fila cheia)", drops - reported_drops);
+            emit_line(LG_WARN, wall_ns(), msg);
+            reported_drops = drops;
+        }
+        if (out) fflush(out);
+        if (__atomic_load_n(&stopping, __ATOMIC_ACQUIRE)) break;
+
+        // Fila vazia: dorme até alguém postar. Marca que vai dormir e
+        // olha de novo, como no highway.c; quem postou antes da marca
+        // mudou posted, e o futex_wait volta na hora
+        __atomic_store_n(&sleeping, true, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&r->seq, __ATOMIC_SEQ_CST) != tail + 1 &&
+            __atomic_load_n(&dropped, __ATOMIC_SEQ_CST) == reported_drops &&
+            !__atomic_load_n(&stopping, __ATOMIC_SEQ_CST)) {
+            futex_wait(&posted, seen);
+        }
+        __atomic_store_n(&sleeping, false, __ATOMIC_SEQ_CST);
+    }
+
+    for (int i = 0; i < LG_SITES; i++) {
+        if (sites[i].fmt) report_suppressed(&sites[i], wall_ns());
+    }
+    return NULL;
+}
+
+// Abre o destino (NULL = GH_LOG) e inicia a thread de fundo
+int lg_open(const char *target) {
+    if (running) return 0;
+    if (target == NULL) target = getenv("GH_LOG");
+
+    if (target != NULL && strcmp(target, "syslog") == 0) {
+        openlog("guitar_hero", LOG_PID, LOG_USER);
+        use_syslog = true;
+    } else if (target != NULL) {
+        out = fopen(target, "a");
+        if (out == NULL) {
+            perror("Falha ao abrir log, usando stderr");
+        }
+    }
+
+    for (uint64_t i = 0; i < LG_RING; i++) ring[i].seq = i;
+    head = tail = 0;
+    stopping = false;
+    if (pthread_create(&thread, NULL, lg_thread, NULL) != 0) {
+        perror("Falha ao criar thread de log");
+        return -1;
+    }
+    __atomic_store_n(&running, true, __ATOMIC_RELEASE);
+    return 0;
+}
+
+// Esvazia a fila e volta para a escrita direta em stderr
+void lg_close(void) {
+    if (!running) return;
+    __atomic_store_n(&running, false, __ATOMIC_RELEASE);
+    __atomic_store_n(&stopping, true, __ATOMIC_SEQ_CST);
+    wake_consumer();
+    pthread_join(thread, NULL);
+
+    if (out) fclose(out);
+    if (use_syslog) closelog();
+    out = NULL;
+    use_syslog = false;
+}
+
+static void post(LgLevel level, int err, bool now, const char *fmt, va_list ap) {
+    if (!__atomic_load_n(&running, __ATOMIC_ACQUIRE)) {
+        LgRecord r;
+        fill(&r, level, err, now, fmt, ap);
+        emit(&r);
+        return;
+    }
+
+    uint64_t pos = __atomic_load_n(&head, __ATOMIC_RELAXED);
+    LgRecord *r;
+    for (;;) {
+        r = &ring[pos & (LG_RING - 1)];
+        uint64_t seq = __atomic_load_n(&r->seq, __ATOMIC_ACQUIRE);
+        int64_t diff = (int64_t)(seq - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&head, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            __atomic_fetch_add(&dropped, 1, __ATOMIC_SEQ_CST);
+            wake_consumer();
+            return;
+        } else {
+            pos = __atomic_load_n(&head, __ATOMIC_RELAXED);
+        }
+    }
+
+    fill(r, level, err, now, fmt, ap);
+    __atomic_store_n(&r->seq, pos + 1, __ATOMIC_RELEASE);
+    wake_consumer();
+}
+
+void lg_post(LgLevel level, int err, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    post(level, err, false, fmt, ap);
+    va_end(ap);
+}
+
+void lg_postf(LgLevel level, int err, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    post(level, err, true, fmt, ap);
+    va_end(ap);
+}
@@ -0,0 +1,49 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <errno.h>
+
+// Diagnóstico fora da thread do jogo. lg_post só copia o formato e os
+// argumentos para um registro de tamanho fixo numa fila circular sem
+// trava; uma thread de fundo formata, limita a taxa por ponto de chamada e
+// grava no destino de GH_LOG:
+//
+//   (não definido)  stderr
+//   syslog          syslog(3), facility LOG_USER
+//   <caminho>       arquivo, em modo append
+//
+// A formatação é adiada, então o formato precisa ser literal e os
+// argumentos só podem ser inteiros (com h, l, ll ou z) ou strings
+// estáticas, no máximo LG_MAX_ARGS; cada um é lido com o tipo que a
+// conversão indica. Fora do laço do jogo, lg_postf formata na hora
+// (aceita qualquer argumento) e só copia o texto para a fila. Antes de
+// lg_open (e depois de lg_close) a mensagem sai na hora em stderr. Com a
+// fila cheia a mensagem é descartada e contada, nunca bloqueia. Com a
+// fila vazia a thread de fundo dorme num futex até a próxima mensagem.
+
+#define LG_RING 1024          // Registros na fila (potência de 2)
+#define LG_MAX_ARGS 6
+#define LG_TEXT 128           // Texto já formatado de lg_postf
+#define LG_RATE 5             // Mensagens por segundo por ponto de chamada
+#define LG_SITES 64           // Pontos de chamada acompanhados pelo limite
+
+typedef enum {
+    LG_DEBUG,
+    LG_INFO,
+    LG_WARN,
+    LG_ERROR
+} LgLevel;
+
+int lg_open(const char *target);
+void lg_close(void);
+// Formato conferido pelo compilador (-Wall) em cada chamada
+void lg_post(LgLevel level, int err, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+void lg_postf(LgLevel level, int err, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+
+#define lg_info(...) lg_post(LG_INFO, 0, __VA_ARGS__)
+#define lg_warn(...) lg_post(LG_WARN, 0, __VA_ARGS__)
+#define lg_error(...) lg_post(LG_ERROR, 0, __VA_ARGS__)
+// Como perror: acrescenta strerror(errno)
+#define lg_perror(msg) lg_post(LG_ERROR, errno, msg)
+
+#endif
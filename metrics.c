@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "metrics.h"
+#include "logger.h"
+
+// Sem o segmento as métricas vão para uma cópia local: quem publica não
+// precisa testar nada
+static MtFile local;
+static MtFile *mt = &local;
+
+static const struct {
+    MtKind kind;
+    const char *name;
+} defs[MT_COUNT] = {
+    [MT_FRAMES]       = { MT_COUNTER, "quadros" },
+    [MT_FPS]          = { MT_GAUGE,   "fps" },
+    [MT_FRAME_P99_US] = { MT_GAUGE,   "quadro_p99_us" },
+    [MT_IOCTLS]       = { MT_COUNTER, "ioctls" },
+    [MT_INPUT_EVENTS] = { MT_COUNTER, "eventos_entrada" },
+    [MT_HITS]         = { MT_COUNTER, "acertos" },
+    [MT_MISSES]       = { MT_COUNTER, "erros" },
+    [MT_SCORE]        = { MT_GAUGE,   "pontuacao" },
+    [MT_SONG]         = { MT_TEXT,    "musica" },
+    [MT_FRAMES_DRAWN] = { MT_COUNTER, "quadros_desenhados" },
+    [MT_FRAMES_SKIPPED] = { MT_COUNTER, "quadros_pulados" },
+};
+
+// Intervalos entre quadros da janela atual
+static uint32_t hist[MT_HIST_BUCKETS];
+static uint32_t window_frames = 0;
+static uint64_t window_start_ns = 0;
+static uint64_t last_frame_ns = 0;
+
+static void init_slots(MtFile *f) {
+    f->version = MT_VERSION;
+    f->slot_count = MT_COUNT;
+    f->slot_size = sizeof(MtSlot);
+    f->pid = getpid();
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    f->start_ns = (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+    for (int i = 0; i < MT_COUNT; i++) {
+        f->slots[i].kind = defs[i].kind;
+        snprintf(f->slots[i].name, MT_NAME_LEN, "%s", defs[i].name);
+    }
+    __atomic_store_n(&f->magic, MT_MAGIC, __ATOMIC_RELEASE);
+}
+
+// Cria (ou recria) o segmento. NULL = GH_METRICS
+int mt_open(const char *name) {
+    if (name == NULL) name = getenv("GH_METRICS");
+    if (name == NULL) name = MT_DEFAULT_NAME;
+    init_slots(&local);
+
+    // Recria do zero: um leitor que ainda tenha o antigo mapeado continua
+    // vendo a instância anterior, não uma mistura
+    shm_unlink(name);
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        lg_postf(LG_ERROR, errno, "Falha ao criar segmento de metricas %s", name);
+        return -1;
+    }
+    if (ftruncate(fd, sizeof(MtFile)) < 0) {
+        lg_postf(LG_ERROR, errno, "Falha ao criar segmento de metricas %s", name);
+        close(fd);
+        shm_unlink(name);
+        return -1;
+    }
+    MtFile *f = mmap(NULL, sizeof(MtFile), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (f == MAP_FAILED) {
+        lg_postf(LG_ERROR, errno, "Falha ao mapear segmento de metricas %s", name);
+        shm_unlink(name);
+        return -1;
+    }
+
+    init_slots(f);
+    mt = f;
+    return 0;
+}
+
+// O segmento fica com os últimos valores; o ghstat vê pelo pid que o jogo
+// saiu
+void mt_close(void) {
+    if (mt != &local) munmap(mt, sizeof(MtFile));
+    mt = &local;
+}
+
+static void write_begin(MtSlot *s) {
+    __atomic_store_n(&s->seq, s->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void write_end(MtSlot *s) {
+    __atomic_store_n(&s->seq, s->seq + 1, __ATOMIC_RELEASE);
+}
+
+void mt_add(MtId id, int64_t n) {
+    MtSlot *s = &mt->slots[id];
+    write_begin(s);
+    __atomic_store_n(&s->value, s->value + n, __ATOMIC_RELAXED);
+    write_end(s);
+}
+
+void mt_set(MtId id, int64_t value) {
+    MtSlot *s = &mt->slots[id];
+    write_begin(s);
+    __atomic_store_n(&s->value, value, __ATOMIC_RELAXED);
+    write_end(s);
+}
+
+void mt_text(MtId id, const char *text) {
+    MtSlot *s = &mt->slots[id];
+    write_begin(s);
+    snprintf(s->text, MT_TEXT_LEN, "%s", text);
+    write_end(s);
+}
+
+static int64_t p99_us(void) {
+    uint32_t target = window_frames - window_frames / 100;
+    uint32_t acc = 0;
+    for (int i = 0; i < MT_HIST_BUCKETS; i++) {
+        acc += hist[i];
+        if (acc >= target) return (int64_t)(i + 1) * MT_HIST_STEP_US;
+    }
+    return (int64_t)MT_HIST_BUCKETS * MT_HIST_STEP_US;
+}
+
+// Marca o início de um quadro. A cada MT_WINDOW_NS publica FPS e p99 do
+// intervalo entre quadros
+void mt_frame(uint64_t now_ns) {
+    mt_add(MT_FRAMES, 1);
+    if (last_frame_ns == 0) {
+        last_frame_ns = window_start_ns = now_ns;
+        return;
+    }
+
+    uint64_t bucket = (now_ns - last_frame_ns) / (MT_HIST_STEP_US * 1000);
+    hist[bucket < MT_HIST_BUCKETS ? bucket : MT_HIST_BUCKETS - 1]++;
+    window_frames++;
+    last_frame_ns = now_ns;
+
+    uint64_t elapsed = now_ns - window_start_ns;
+    if (elapsed < MT_WINDOW_NS) return;
+
+    mt_set(MT_FPS, (int64_t)((window_frames * 1000000000ull + elapsed / 2) / elapsed));
+    mt_set(MT_FRAME_P99_US, p99_us());
+    __atomic_store_n(&mt->updated_ns, now_ns, __ATOMIC_RELEASE);
+    memset(hist, 0, sizeof(hist));
+    window_frames = 0;
+    window_start_ns = now_ns;
+}
+
+// Fora da partida não há quadros: a pausa não entra no p99
+void mt_frames_stop(void) {
+    memset(hist, 0, sizeof(hist));
+    window_frames = 0;
+    last_frame_ns = 0;
+    mt_set(MT_FPS, 0);
+}
+
+void mt_read(const MtSlot *slot, MtSlot *out) {
+    uint32_t seq;
+    do {
+        seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        memcpy(out, slot, sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((seq & 1) || seq != __atomic_load_n(&slot->seq, __ATOMIC_RELAXED));
+    out->text[MT_TEXT_LEN - 1] = '\0';
+}
@@ -0,0 +1,74 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+
+// Métricas ao vivo num segmento de memória compartilhada POSIX (shm_open),
+// para o ghstat ler de fora sem conversar com o jogo. Cada métrica ocupa
+// uma linha de cache própria com seqlock: o jogo é o único escritor e
+// nunca espera; o leitor só lê e repete se pegar uma escrita no meio.
+// O nome do segmento vem de GH_METRICS (padrão MT_DEFAULT_NAME).
+
+#define MT_DEFAULT_NAME "/guitar_hero_metrics"
+#define MT_MAGIC 0x314d4847   // "GHM1"
+#define MT_VERSION 1
+#define MT_NAME_LEN 24
+#define MT_TEXT_LEN 24
+#define MT_WINDOW_NS 1000000000ull // Janela do FPS e do p99
+#define MT_HIST_STEP_US 10    // Histograma do tempo de quadro em passos de
+#define MT_HIST_BUCKETS 5000  // 10us, até 50ms
+
+typedef enum {
+    MT_COUNTER,               // Total desde o início; o leitor tira a taxa
+    MT_GAUGE,                 // Valor atual
+    MT_TEXT
+} MtKind;
+
+// Ordem dos slots no segmento; acrescentar só no fim
+typedef enum {
+    MT_FRAMES,
+    MT_FPS,                   // Quadros na última janela
+    MT_FRAME_P99_US,          // p99 do intervalo entre quadros na janela
+    MT_IOCTLS,
+    MT_INPUT_EVENTS,
+    MT_HITS,
+    MT_MISSES,
+    MT_SCORE,
+    MT_SONG,
+    MT_FRAMES_DRAWN,          // Escrito pela thread de desenho
+    MT_FRAMES_SKIPPED,        // Cenas trocadas antes de serem desenhadas
+    MT_COUNT
+} MtId;
+
+typedef struct __attribute__((aligned(64))) {
+    uint32_t seq;             // Ímpar durante a escrita
+    uint32_t kind;
+    char name[MT_NAME_LEN];
+    int64_t value;
+    char text[MT_TEXT_LEN];
+} MtSlot;
+
+typedef struct __attribute__((aligned(64))) {
+    uint32_t magic;           // Gravado por último, depois dos nomes
+    uint32_t version;
+    uint32_t slot_count;
+    uint32_t slot_size;
+    int32_t pid;
+    uint32_t reserved;
+    int64_t start_ns;         // CLOCK_REALTIME da abertura
+    uint64_t updated_ns;      // CLOCK_MONOTONIC da última janela publicada
+    MtSlot slots[MT_COUNT];
+} MtFile;
+
+int mt_open(const char *name);
+void mt_close(void);
+void mt_add(MtId id, int64_t n);
+void mt_set(MtId id, int64_t value);
+void mt_text(MtId id, const char *text);
+void mt_frame(uint64_t now_ns);
+void mt_frames_stop(void);
+
+// Leitura consistente de um slot (para o ghstat)
+void mt_read(const MtSlot *slot, MtSlot *out);
+
+#endif
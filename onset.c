@@ -0,0 +1,377 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "onset.h"
+#include "logger.h"
+
+#define WAV_PCM 1
+#define WAV_FLOAT 3
+#define WAV_EXTENSIBLE 0xFFFE
+
+static uint32_t rd16(const uint8_t *p) {
+    return p[0] | p[1] << 8;
+}
+
+static uint32_t rd32(const uint8_t *p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static float decode_sample(const uint8_t *s, int format, int bits) {
+    switch (bits) {
+    case 8:
+        return (s[0] - 128) / 128.0f;
+    case 16:
+        return (int16_t)rd16(s) / 32768.0f;
+    case 24:
+        return (int32_t)(s[0] << 8 | s[1] << 16 | (uint32_t)s[2] << 24) / 2147483648.0f;
+    default:
+        if (format == WAV_FLOAT) {
+            float v;
+            uint32_t raw = rd32(s);
+            memcpy(&v, &raw, sizeof(v));
+            return v;
+        }
+        return (int32_t)rd32(s) / 2147483648.0f;
+    }
+}
+
+void audio_free(Audio *audio) {
+    free(audio->samples);
+    audio->samples = NULL;
+    audio->count = 0;
+}
+
+// Lê um WAV PCM (8/16/24/32 bits) ou float de 32 bits, misturando os
+// canais em mono. O arquivo é mapeado e decodificado direto do mapeamento
+int wav_load(const char *path, Audio *audio) {
+    memset(audio, 0, sizeof(*audio));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        lg_postf(LG_ERROR, errno, "%s", path);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < 12) {
+        lg_postf(LG_ERROR, 0, "%s: arquivo curto demais", path);
+        close(fd);
+        return -1;
+    }
+    size_t len = st.st_size;
+    const uint8_t *p = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        lg_postf(LG_ERROR, errno, "%s", path);
+        return -1;
+    }
+    madvise((void *)p, len, MADV_SEQUENTIAL);
+
+    const uint8_t *fmt = NULL, *data = NULL;
+    size_t fmt_len = 0, data_len = 0;
+    if (memcmp(p, "RIFF", 4) == 0 && memcmp(p + 8, "WAVE", 4) == 0) {
+        size_t off = 12;
+        while (off + 8 <= len) {
+            size_t size = rd32(p + off + 4);
+            size_t body = off + 8;
+            if (size > len - body) size = len - body;
+            if (memcmp(p + off, "fmt ", 4) == 0) {
+                fmt = p + body;
+                fmt_len = size;
+            } else if (memcmp(p + off, "data", 4) == 0) {
+                data = p + body;
+                data_len = size;
+            }
+            off = body + size + (size & 1);
+        }
+    }
+
+    int format = 0, channels = 0, bits = 0;
+    if (fmt != NULL && fmt_len >= 16) {
+        format = rd16(fmt);
+        channels = rd16(fmt + 2);
+        audio->rate = rd32(fmt + 4);
+        bits = rd16(fmt + 14);
+        if (format == WAV_EXTENSIBLE && fmt_len >= 26) format = rd16(fmt + 24);
+    }
+
+    bool ok = data != NULL && channels > 0 && audio->rate > 0 &&
+              ((format == WAV_PCM && (bits == 8 || bits == 16 || bits == 24 || bits == 32)) ||
+               (format == WAV_FLOAT && bits == 32));
+    if (!ok) {
+        lg_postf(LG_ERROR, 0, "%s: WAV nao suportado (formato %d, %d bits)", path, format, bits);
+        munmap((void *)p, len);
+        return -1;
+    }
+
+    int step = channels * (bits / 8);
+    audio->count = data_len / step;
+    audio->samples = malloc((audio->count ? audio->count : 1) * sizeof(float));
+    if (audio->samples == NULL) {
+        lg_perror("Falha ao alocar audio");
+        munmap((void *)p, len);
+        return -1;
+    }
+
+    for (int i = 0; i < audio->count; i++) {
+        const uint8_t *frame = data + (size_t)i * step;
+        float sum = 0;
+        for (int c = 0; c < channels; c++) sum += decode_sample(frame + c * (bits / 8), format, bits);
+        audio->samples[i] = sum / channels;
+    }
+
+    munmap((void *)p, len);
+    return 0;
+}
+
+// FFT complexa radix-2 em estruturas separadas (re[], im[]), com os fatores
+// de cada estágio contíguos para que as borboletas andem de 4 em 4 no SSE
+typedef struct {
+    int n;
+    int *bitrev;
+    float *tw_re;             // Estágio de meia-largura h começa em h - 1
+    float *tw_im;
+    float *window;            // Hann
+} Fft;
+
+static void fft_free(Fft *f) {
+    free(f->bitrev);
+    free(f->tw_re);
+    free(f->tw_im);
+    free(f->window);
+}
+
+static int fft_init(Fft *f, int n) {
+    f->n = n;
+    f->bitrev = malloc(n * sizeof(int));
+    f->tw_re = malloc(n * sizeof(float));
+    f->tw_im = malloc(n * sizeof(float));
+    f->window = malloc(n * sizeof(float));
+    if (!f->bitrev || !f->tw_re || !f->tw_im || !f->window) {
+        fft_free(f);
+        return -1;
+    }
+
+    int bits = 0;
+    while ((1 << bits) < n) bits++;
+    for (int i = 0; i < n; i++) {
+        int r = 0;
+        for (int b = 0; b < bits; b++) r |= ((i >> b) & 1) << (bits - 1 - b);
+        f->bitrev[i] = r;
+        f->window[i] = 0.5f - 0.5f * cosf(2 * (float)M_PI * i / n);
+    }
+    for (int half = 1; half < n; half <<= 1) {
+        for (int k = 0; k < half; k++) {
+            f->tw_re[half - 1 + k] = cosf((float)M_PI * k / half);
+            f->tw_im[half - 1 + k] = -sinf((float)M_PI * k / half);
+        }
+    }
+    return 0;
+}
+
+// Entrada já em ordem de bits invertidos
+static void fft_run(const Fft *f, float *re, float *im) {
+    int n = f->n;
+    for (int half = 1; half < n; half <<= 1) {
+        const float *wr = f->tw_re + half - 1;
+        const float *wi = f->tw_im + half - 1;
+        for (int start = 0; start < n; start += 2 * half) {
+            float *ar = re + start, *ai = im + start;
+            float *br = ar + half, *bi = ai + half;
+            int k = 0;
+#ifdef __SSE2__
+            for (; k + 4 <= half; k += 4) {
+                __m128 xr = _mm_loadu_ps(br + k), xi = _mm_loadu_ps(bi + k);
+                __m128 cr = _mm_loadu_ps(wr + k), ci = _mm_loadu_ps(wi + k);
+                __m128 tr = _mm_sub_ps(_mm_mul_ps(xr, cr), _mm_mul_ps(xi, ci));
+                __m128 ti = _mm_add_ps(_mm_mul_ps(xr, ci), _mm_mul_ps(xi, cr));
+                __m128 yr = _mm_loadu_ps(ar + k), yi = _mm_loadu_ps(ai + k);
+                _mm_storeu_ps(br + k, _mm_sub_ps(yr, tr));
+                _mm_storeu_ps(bi + k, _mm_sub_ps(yi, ti));
+                _mm_storeu_ps(ar + k, _mm_add_ps(yr, tr));
+                _mm_storeu_ps(ai + k, _mm_add_ps(yi, ti));
+            }
+#endif
+            for (; k < half; k++) {
+                float tr = br[k] * wr[k] - bi[k] * wi[k];
+                float ti = br[k] * wi[k] + bi[k] * wr[k];
+                br[k] = ar[k] - tr;
+                bi[k] = ai[k] - ti;
+                ar[k] += tr;
+                ai[k] += ti;
+            }
+        }
+    }
+}
+
+static void magnitudes(const float *re, const float *im, float *mag, int bins) {
+    int k = 0;
+#ifdef __SSE2__
+    for (; k + 4 <= bins; k += 4) {
+        __m128 r = _mm_loadu_ps(re + k), i = _mm_loadu_ps(im + k);
+        _mm_storeu_ps(mag + k, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(r, r), _mm_mul_ps(i, i))));
+    }
+#endif
+    for (; k < bins; k++) mag[k] = sqrtf(re[k] * re[k] + im[k] * im[k]);
+}
+
+// Autocorrelação do fluxo, com preferência por andamentos perto de 120
+// BPM para não cair no dobro ou na metade
+static float estimate_bpm(const float *flux, int frames, float fps) {
+    int min_lag = (int)(fps * 60 / ONSET_MAX_BPM);
+    int max_lag = (int)(fps * 60 / ONSET_MIN_BPM) + 1;
+    if (min_lag < 2 || max_lag + 1 >= frames) return 0;
+
+    float *acf = calloc(max_lag + 2, sizeof(float));
+    if (acf == NULL) return 0;
+    for (int lag = min_lag - 1; lag <= max_lag + 1; lag++) {
+        float sum = 0;
+        for (int f = 0; f + lag < frames; f++) {
+            float a = flux[f] > 0 ? flux[f] : 0;
+            float b = flux[f + lag] > 0 ? flux[f + lag] : 0;
+            sum += a * b;
+        }
+        acf[lag] = sum / (frames - lag);
+    }
+
+    int best = 0;
+    float best_score = 0;
+    for (int lag = min_lag; lag <= max_lag; lag++) {
+        float octaves = log2f(60 * fps / lag / 120);
+        float score = acf[lag] * expf(-0.5f * octaves * octaves);
+        if (score > best_score) {
+            best_score = score;
+            best = lag;
+        }
+    }
+
+    float bpm = 0;
+    if (best > 0) {
+        // Interpolação parabólica em torno do pico
+        float a = acf[best - 1], b = acf[best], c = acf[best + 1];
+        float den = a - 2 * b + c;
+        float d = den != 0 ? 0.5f * (a - c) / den : 0;
+        if (d > 0.5f || d < -0.5f) d = 0;
+        bpm = 60 * fps / (best + d);
+    }
+    free(acf);
+    return bpm;
+}
+
+void onset_free(OnsetResult *result) {
+    free(result->onsets);
+    result->onsets = NULL;
+    result->count = 0;
+}
+
+int onset_detect(const Audio *audio, OnsetResult *out) {
+    memset(out, 0, sizeof(*out));
+
+    int target = audio->rate * ONSET_WINDOW_MS / 1000;
+    int n = 256;
+    while (n * 3 / 2 < target) n <<= 1;
+    int hop = n / 2;
+    int bins = n / 2 + 1;
+    int frames = audio->count >= n ? (audio->count - n) / hop + 1 : 0;
+    if (frames < 3) return 0;
+
+    Fft fft;
+    if (fft_init(&fft, n) < 0) {
+        lg_perror("Falha ao alocar FFT");
+        return -1;
+    }
+    float *re = malloc(n * sizeof(float));
+    float *im = malloc(n * sizeof(float));
+    float *mag = malloc(bins * sizeof(float));
+    float *prev = calloc(bins, sizeof(float));
+    float *flux = calloc(frames, sizeof(float));
+    float *centroid = calloc(frames, sizeof(float));
+    out->onsets = malloc(frames * sizeof(Onset));
+    if (!re || !im || !mag || !prev || !flux || !centroid || !out->onsets) {
+        lg_perror("Falha ao alocar STFT");
+        onset_free(out);
+        frames = -1;
+        goto done;
+    }
+
+    // STFT: fluxo espectral (só aumentos de energia, em escala log) e
+    // centroide de cada janela
+    for (int f = 0; f < frames; f++) {
+        const float *src = audio->samples + (size_t)f * hop;
+        for (int i = 0; i < n; i++) {
+            re[fft.bitrev[i]] = src[i] * fft.window[i];
+            im[i] = 0;
+        }
+        fft_run(&fft, re, im);
+        magnitudes(re, im, mag, bins);
+
+        float fl = 0, sum = 0, weighted = 0;
+        for (int k = 0; k < bins; k++) {
+            float l = log1pf(mag[k]);
+            if (l > prev[k]) fl += l - prev[k];
+            prev[k] = l;
+            sum += mag[k];
+            weighted += k * mag[k];
+        }
+        flux[f] = f > 0 ? fl : 0;
+        centroid[f] = sum > 0 ? weighted / sum * audio->rate / n : 0;
+    }
+
+    // Normaliza para média 0 e desvio 1: o limiar não depende do volume
+    double mean = 0, var = 0;
+    for (int f = 0; f < frames; f++) mean += flux[f];
+    mean /= frames;
+    for (int f = 0; f < frames; f++) var += (flux[f] - mean) * (flux[f] - mean);
+    float std = sqrtf(var / frames);
+    if (std == 0) goto done;
+    for (int f = 0; f < frames; f++) flux[f] = (flux[f] - mean) / std;
+
+    // Picos: máximo local, acima da média local mais ONSET_DELTA e longe
+    // o bastante do anterior
+    float fps = (float)audio->rate / hop;
+    int peak_r = (int)(ONSET_PEAK_MS * fps / 1000) + 1;
+    int mean_r = (int)(ONSET_MEAN_MS * fps / 1000) + 1;
+    int gap = (int)(ONSET_MIN_GAP_MS * fps / 1000) + 1;
+    int last = -gap;
+    for (int f = 1; f < frames; f++) {
+        bool is_max = true;
+        float local = 0;
+        int lo = f - mean_r < 0 ? 0 : f - mean_r;
+        int hi = f + mean_r >= frames ? frames - 1 : f + mean_r;
+        for (int j = lo; j <= hi; j++) {
+            local += flux[j];
+            if (j >= f - peak_r && j <= f + peak_r && flux[j] > flux[f]) is_max = false;
+        }
+        local /= hi - lo + 1;
+
+        if (is_max && flux[f] > local + ONSET_DELTA && f - last >= gap) {
+            Onset *o = &out->onsets[out->count++];
+            o->time_s = ((float)f * hop + n / 2) / audio->rate;
+            o->strength = flux[f];
+            o->centroid = centroid[f];
+            last = f;
+        }
+    }
+    out->bpm = estimate_bpm(flux, frames, fps);
+
+done:
+    free(re);
+    free(im);
+    free(mag);
+    free(prev);
+    free(flux);
+    free(centroid);
+    fft_free(&fft);
+    return frames < 0 ? -1 : 0;
+}
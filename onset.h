@@ -0,0 +1,38 @@
+#ifndef ONSET_H
+#define ONSET_H
+
+// Análise de áudio do ghchart: leitura de WAV, STFT com FFT vetorizada,
+// detecção de ataques por fluxo espectral e estimativa de andamento.
+
+#define ONSET_WINDOW_MS 23    // Janela da STFT (arredondada para potência de 2)
+#define ONSET_PEAK_MS 30      // Raio do máximo local
+#define ONSET_MEAN_MS 100     // Raio da média do limiar adaptativo
+#define ONSET_MIN_GAP_MS 50   // Distância mínima entre ataques
+#define ONSET_DELTA 0.5f      // Limiar acima da média, em desvios-padrão
+#define ONSET_MIN_BPM 60
+#define ONSET_MAX_BPM 200
+
+typedef struct {
+    float *samples;           // Mono, em [-1, 1]
+    int count;
+    int rate;
+} Audio;
+
+typedef struct {
+    float time_s;
+    float strength;           // Fluxo normalizado no pico
+    float centroid;           // Centroide espectral (Hz), usado para a pista
+} Onset;
+
+typedef struct {
+    Onset *onsets;            // Em ordem de tempo
+    int count;
+    float bpm;                // 0 se não deu para estimar
+} OnsetResult;
+
+int wav_load(const char *path, Audio *audio);
+void audio_free(Audio *audio);
+int onset_detect(const Audio *audio, OnsetResult *out);
+void onset_free(OnsetResult *result);
+
+#endif
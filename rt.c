@@ -0,0 +1,149 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#include "rt.h"
+#include "logger.h"
+
+static bool rt_enabled = false;
+static int role_cpu[RT_ROLES] = { [0 ... RT_ROLES - 1] = -1 };
+static int rt_prio = RT_DEFAULT_PRIO;
+static cpu_set_t base_cpus;   // Afinidade do processo antes de fixar qualquer thread
+
+// Latência de despertar em us; o último balde acumula o que passar disso
+static uint32_t hist[RT_HIST_US + 1];
+static uint64_t samples = 0;
+static uint64_t max_ns = 0;
+
+// Lê GH_RT*, trava a memória. Retorna se o modo está ligado
+bool rt_init(void) {
+    const char *on = getenv("GH_RT");
+    if (on == NULL || strcmp(on, "0") == 0) return false;
+    rt_enabled = true;
+
+    const char *cpus = getenv("GH_RT_CPUS");
+    for (int role = 0; cpus != NULL && *cpus && role < RT_ROLES; role++) {
+        char *end;
+        long cpu = strtol(cpus, &end, 10);
+        if (end == cpus) break;
+        role_cpu[role] = (int)cpu;
+        cpus = (*end == ',') ? end + 1 : end;
+    }
+
+    const char *prio = getenv("GH_RT_PRIO");
+    if (prio != NULL) rt_prio = atoi(prio);
+
+    if (sched_getaffinity(0, sizeof(base_cpus), &base_cpus) < 0) {
+        CPU_ZERO(&base_cpus);
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) CPU_SET(cpu, &base_cpus);
+    }
+
+    // Sem CAP_IPC_LOCK o limite de RLIMIT_MEMLOCK costuma ser pequeno;
+    // nesse caso seguimos sem travar, só avisando
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0) {
+        lg_post(LG_WARN, errno, "mlockall indisponivel");
+    }
+    return true;
+}
+
+// Encosta na pilha para as páginas existirem antes do primeiro quadro
+static void prefault_stack(void) {
+    volatile char stack[RT_STACK_PREFAULT];
+    for (size_t i = 0; i < sizeof(stack); i += 4096) stack[i] = 0;
+}
+
+// CPUs do processo menos as fixadas para os papéis; se não sobrar
+// nenhuma, todas as do processo
+static void free_cpus(cpu_set_t *set) {
+    *set = base_cpus;
+    for (int role = 0; role < RT_ROLES; role++) {
+        if (role_cpu[role] >= 0) CPU_CLR(role_cpu[role], set);
+    }
+    if (CPU_COUNT(set) == 0) *set = base_cpus;
+}
+
+// Aplica afinidade e prioridade à thread que chama. Sem CPU própria o
+// papel fica nas CPUs livres, e não na do jogo, herdada de quem criou a
+// thread. O áudio fica um nível acima do jogo: o bloco é curto e, se
+// atrasar, estala
+void rt_enter_thread(RtRole role) {
+    if (!rt_enabled) return;
+
+    cpu_set_t set;
+    if (role_cpu[role] >= 0) {
+        CPU_ZERO(&set);
+        CPU_SET(role_cpu[role], &set);
+    } else {
+        free_cpus(&set);
+    }
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err) lg_post(LG_WARN, err, "Afinidade do papel %d falhou", (int)role);
+
+    struct sched_param sp = { .sched_priority = role == RT_AUDIO ? rt_prio + 1 : rt_prio };
+    err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp);
+    if (err) {
+        // Sem privilégio: o melhor que dá é subir a prioridade normal
+        lg_post(LG_WARN, err, "SCHED_FIFO indisponivel, usando nice");
+        if (setpriority(PRIO_PROCESS, 0, -10) < 0) {
+            lg_post(LG_WARN, errno, "Nice -10 indisponivel, prioridade normal");
+        }
+    }
+
+    prefault_stack();
+}
+
+// Thread auxiliar (desenho): criada pelo jogo, herdaria SCHED_FIFO (ou o
+// nice) e a CPU dele. Volta para o escalonamento normal nas CPUs livres,
+// para nunca disputar a CPU com o jogo
+void rt_background_thread(void) {
+    if (!rt_enabled) return;
+
+    cpu_set_t set;
+    free_cpus(&set);
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err) lg_post(LG_WARN, err, "Afinidade da thread auxiliar falhou");
+
+    struct sched_param sp = { .sched_priority = 0 };
+    err = pthread_setschedparam(pthread_self(), SCHED_OTHER, &sp);
+    if (err) lg_post(LG_WARN, err, "Thread auxiliar continua em SCHED_FIFO");
+    setpriority(PRIO_PROCESS, 0, 0);
+}
+
+// Registra o atraso entre o instante pedido e o despertar real
+void rt_record_wakeup(uint64_t deadline_ns, uint64_t now_ns) {
+    uint64_t late = now_ns > deadline_ns ? now_ns - deadline_ns : 0;
+    uint64_t us = late / 1000;
+    hist[us < RT_HIST_US ? us : RT_HIST_US]++;
+    if (late > max_ns) max_ns = late;
+    samples++;
+}
+
+static uint64_t percentile(double p) {
+    uint64_t target = (uint64_t)(samples * p);
+    uint64_t acc = 0;
+    for (int us = 0; us <= RT_HIST_US; us++) {
+        acc += hist[us];
+        if (acc > target) return us;
+    }
+    return RT_HIST_US;
+}
+
+void rt_report(void) {
+    if (samples == 0) {
+        printf("Latencia de despertar: 0 amostras\n");
+        return;
+    }
+    printf("Latencia de despertar (%llu amostras): p50 %lluus p90 %lluus "
+           "p99 %lluus p99.9 %lluus max %lluus\n",
+           (unsigned long long)samples,
+           (unsigned long long)percentile(0.50), (unsigned long long)percentile(0.90),
+           (unsigned long long)percentile(0.99), (unsigned long long)percentile(0.999),
+           (unsigned long long)(max_ns / 1000));
+}
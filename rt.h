@@ -0,0 +1,31 @@
+#ifndef RT_H
+#define RT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Modo tempo real opcional (GH_RT=1): SCHED_FIFO, afinidade de CPU e
+// memória travada. O histograma da latência de despertar é sempre
+// coletado, para comparar em cada gabinete com e sem o modo.
+//
+// GH_RT_CPUS  lista de CPUs por papel, na ordem de RtRole, ex.: "2,3";
+//             papel sem CPU fica nas que não foram dadas a nenhum
+// GH_RT_PRIO  prioridade SCHED_FIFO (padrão RT_DEFAULT_PRIO)
+
+#define RT_DEFAULT_PRIO 50
+#define RT_STACK_PREFAULT (256 * 1024)
+#define RT_HIST_US 20000      // Histograma com resolução de 1us até 20ms
+
+typedef enum {
+    RT_GAME,                  // Simulação, entrada e julgamento
+    RT_AUDIO,                 // Música no modo treino (audio_out)
+    RT_ROLES
+} RtRole;
+
+bool rt_init(void);
+void rt_enter_thread(RtRole role);
+void rt_background_thread(void);
+void rt_record_wakeup(uint64_t deadline_ns, uint64_t now_ns);
+void rt_report(void);
+
+#endif
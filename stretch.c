@@ -0,0 +1,105 @@
+#include <string.h>
+#include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "stretch.h"
+
+void st_init(Stretch *st, const float *samples, int count) {
+    st->in = samples;
+    st->count = count;
+    // Hann periódica: com 50% de sobreposição as janelas somam 1
+    for (int i = 0; i < ST_FRAME; i++) {
+        st->window[i] = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * i / ST_FRAME);
+    }
+    st_reset(st);
+}
+
+// Esquece o quadro anterior (início, pausa, salto)
+void st_reset(Stretch *st) {
+    st->prev = -1;
+    memset(st->tail, 0, sizeof(st->tail));
+}
+
+// Produto escalar de a com b e energia de b, em n amostras (múltiplo de 4)
+static void dot_energy(const float *a, const float *b, int n, float *dot, float *energy) {
+    int k = 0;
+    float d = 0, e = 0;
+#ifdef __SSE2__
+    __m128 vd = _mm_setzero_ps(), ve = _mm_setzero_ps();
+    for (; k + 4 <= n; k += 4) {
+        __m128 x = _mm_loadu_ps(a + k), y = _mm_loadu_ps(b + k);
+        vd = _mm_add_ps(vd, _mm_mul_ps(x, y));
+        ve = _mm_add_ps(ve, _mm_mul_ps(y, y));
+    }
+    float sd[4], se[4];
+    _mm_storeu_ps(sd, vd);
+    _mm_storeu_ps(se, ve);
+    d = sd[0] + sd[1] + sd[2] + sd[3];
+    e = se[0] + se[1] + se[2] + se[3];
+#endif
+    for (; k < n; k++) {
+        d += a[k] * b[k];
+        e += b[k] * b[k];
+    }
+    *dot = d;
+    *energy = e;
+}
+
+// Semelhança normalizada do candidato com a continuação natural
+static float score(const Stretch *st, int tpl, int cand) {
+    float dot, energy;
+    dot_energy(st->in + tpl, st->in + cand, ST_HOP, &dot, &energy);
+    return dot / sqrtf(energy + 1e-9f);
+}
+
+// Escolhe o início do quadro perto de nominal que melhor continua o
+// anterior: busca grossa de ST_COARSE em ST_COARSE e refino em volta
+static int best_start(const Stretch *st, int nominal) {
+    int last = st->count - ST_FRAME;
+    int tpl = st->prev + ST_HOP;
+    if (st->prev < 0 || tpl > last) return nominal;
+
+    int lo = nominal - ST_SEEK < 0 ? 0 : nominal - ST_SEEK;
+    int hi = nominal + ST_SEEK > last ? last : nominal + ST_SEEK;
+    int best = nominal;
+    float best_score = -INFINITY;
+    for (int c = lo; c <= hi; c += ST_COARSE) {
+        float s = score(st, tpl, c);
+        if (s > best_score) {
+            best_score = s;
+            best = c;
+        }
+    }
+    int center = best;
+    for (int c = center - ST_COARSE + 1; c < center + ST_COARSE; c++) {
+        if (c < lo || c > hi || c == center) continue;
+        float s = score(st, tpl, c);
+        if (s > best_score) {
+            best_score = s;
+            best = c;
+        }
+    }
+    return best;
+}
+
+// Gera ST_HOP amostras com o quadro centrado, a grosso modo, na posição
+// pos da entrada. Fora do áudio sai silêncio
+void st_render(Stretch *st, double pos, float *out) {
+    int nominal = (int)pos;
+    if (nominal < 0 || nominal > st->count - ST_FRAME) {
+        // Antes do começo ou depois do fim: termina a cauda e silencia
+        memcpy(out, st->tail, sizeof(st->tail));
+        st_reset(st);
+        return;
+    }
+
+    int start = best_start(st, nominal);
+    const float *x = st->in + start;
+    for (int i = 0; i < ST_HOP; i++) {
+        out[i] = st->tail[i] + x[i] * st->window[i];
+        st->tail[i] = x[ST_HOP + i] * st->window[ST_HOP + i];
+    }
+    st->prev = start;
+}
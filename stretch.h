@@ -0,0 +1,28 @@
+#ifndef STRETCH_H
+#define STRETCH_H
+
+// Mudança de velocidade do áudio sem mudar a altura, por WSOLA: cada
+// quadro de saída é um trecho janelado da entrada perto da posição pedida,
+// deslocado até ST_SEEK amostras para continuar o quadro anterior com a
+// maior correlação, e somado com 50% de sobreposição. A posição de cada
+// quadro vem de quem chama (o relógio da música), então a velocidade pode
+// ser qualquer uma e não há deriva.
+
+#define ST_FRAME 1024         // Amostras por quadro (~23 ms a 44,1 kHz)
+#define ST_HOP (ST_FRAME / 2) // Amostras de saída por chamada
+#define ST_SEEK 256           // Deslocamento máximo na busca
+#define ST_COARSE 4           // Passo da busca grossa, refinada em volta
+
+typedef struct {
+    const float *in;
+    int count;
+    int prev;                 // Início do quadro anterior, -1 sem anterior
+    float window[ST_FRAME];
+    float tail[ST_HOP];       // Segunda metade do quadro anterior
+} Stretch;
+
+void st_init(Stretch *st, const float *samples, int count);
+void st_reset(Stretch *st);
+void st_render(Stretch *st, double pos, float *out);
+
+#endif
@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "trace.h"
+#include "logger.h"
+
+typedef struct {
+    uint64_t time_ns;         // CLOCK_MONOTONIC
+    const char *name;
+    long arg;
+    char phase;               // 'B', 'E' ou 'i', como no formato do Chrome
+} TrEvent;
+
+// Anel de uma thread; só ela escreve, o dump é feito depois que parou
+typedef struct {
+    TrEvent *events;
+    uint64_t head;
+    const char *name;
+    int tid;
+} TrRing;
+
+bool tr_on = false;
+static char *out_path = NULL;
+static TrRing rings[TR_MAX_THREADS];
+static int ring_count = 0;
+static __thread TrRing *mine = NULL;
+static pthread_mutex_t register_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Liga o rastro (NULL = GH_TRACE) e registra a thread que chama
+int tr_open(const char *path) {
+    if (path == NULL) path = getenv("GH_TRACE");
+    if (path == NULL) return 0;
+    out_path = strdup(path);
+    tr_on = true;
+    tr_thread("jogo");
+    return 0;
+}
+
+// Registra a thread que chama, com anel pré-tocado para não haver page
+// fault nem malloc no meio do quadro
+void tr_thread(const char *name) {
+    if (!tr_on || mine != NULL) return;
+    pthread_mutex_lock(&register_lock);
+    for (int i = 0; i < ring_count && i < TR_MAX_THREADS; i++) {
+        if (rings[i].events != NULL && strcmp(rings[i].name, name) == 0) mine = &rings[i];
+    }
+    if (mine == NULL && ring_count >= TR_MAX_THREADS) {
+        ring_count++;
+        lg_warn("Rastro: threads demais, esta fica de fora");
+    } else if (mine == NULL) {
+        void *events = mmap(NULL, TR_RING * sizeof(TrEvent), PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+        if (events == MAP_FAILED) {
+            lg_perror("Falha ao reservar anel do rastro");
+        } else {
+            mine = &rings[ring_count++];
+            mine->events = events;
+            mine->name = name;
+        }
+    }
+    if (mine != NULL) mine->tid = (int)syscall(SYS_gettid);
+    pthread_mutex_unlock(&register_lock);
+}
+
+void tr_event(const char *name, char phase, long arg) {
+    TrRing *r = mine;
+    if (r == NULL) return;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    TrEvent *e = &r->events[r->head & (TR_RING - 1)];
+    e->time_ns = (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+    e->name = name;
+    e->arg = arg;
+    e->phase = phase;
+    r->head++;
+}
+
+static void write_ring(FILE *f, const TrRing *r, int pid, bool *first) {
+    fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+               "\"args\":{\"name\":\"%s\"}}", *first ? "" : ",\n", pid, r->tid, r->name);
+    *first = false;
+
+    uint64_t start = r->head > TR_RING ? r->head - TR_RING : 0;
+    int depth = 0;
+    for (uint64_t i = start; i < r->head; i++) {
+        const TrEvent *e = &r->events[i & (TR_RING - 1)];
+        // O anel pode ter sobrescrito o início de fases ainda abertas
+        if (e->phase == 'E' && depth == 0) continue;
+        if (e->phase == 'B') depth++;
+        if (e->phase == 'E') depth--;
+
+        fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu.%03u,\"pid\":%d,\"tid\":%d",
+                e->name, e->phase, (unsigned long long)(e->time_ns / 1000),
+                (unsigned)(e->time_ns % 1000), pid, r->tid);
+        if (e->phase == 'i') fprintf(f, ",\"s\":\"t\"");
+        if (e->phase != 'E' && e->arg) fprintf(f, ",\"args\":{\"v\":%ld}", e->arg);
+        fprintf(f, "}");
+    }
+}
+
+// Grava o arquivo. As outras threads registradas já devem ter parado
+void tr_close(void) {
+    if (!tr_on) return;
+    tr_on = false;
+
+    FILE *f = fopen(out_path, "w");
+    if (f == NULL) {
+        lg_postf(LG_ERROR, errno, "Falha ao gravar rastro %s", out_path);
+    } else {
+        int pid = getpid();
+        bool first = true;
+        int n = ring_count < TR_MAX_THREADS ? ring_count : TR_MAX_THREADS;
+        fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        for (int i = 0; i < n; i++) {
+            if (rings[i].events != NULL) write_ring(f, &rings[i], pid, &first);
+        }
+        fprintf(f, "\n]}\n");
+        fclose(f);
+    }
+
+    for (int i = 0; i < TR_MAX_THREADS; i++) {
+        if (rings[i].events != NULL) munmap(rings[i].events, TR_RING * sizeof(TrEvent));
+        memset(&rings[i], 0, sizeof(rings[i]));
+    }
+    ring_count = 0;
+    mine = NULL;
+    free(out_path);
+    out_path = NULL;
+}
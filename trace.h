@@ -0,0 +1,33 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+
+// Rastro opcional das fases do quadro, para achar a causa de um quadro
+// lento (qual escrita de LED, qual flush do terminal). Com GH_TRACE=arquivo
+// cada thread registrada grava eventos de início/fim e instantâneos num
+// anel próprio, pré-alocado; na saída tudo vira um JSON no formato de
+// rastro do Chrome (abre em chrome://tracing e no ui.perfetto.dev). Com o
+// anel cheio os eventos mais antigos são sobrescritos: fica o fim da
+// partida. Desligado, cada ponto custa um teste de variável global.
+//
+// Os nomes precisam ser strings estáticas: só o ponteiro é guardado. Uma
+// thread nova com o nome de outra que já terminou (áudio e desenho sobem
+// a cada música) continua o anel dela.
+
+#define TR_RING 65536         // Eventos por thread (potência de 2)
+#define TR_MAX_THREADS 8
+
+extern bool tr_on;
+
+int tr_open(const char *path);
+void tr_close(void);
+void tr_thread(const char *name);
+void tr_event(const char *name, char phase, long arg);
+
+#define tr_begin(name) do { if (tr_on) tr_event(name, 'B', 0); } while (0)
+#define tr_end(name) do { if (tr_on) tr_event(name, 'E', 0); } while (0)
+#define tr_begin_arg(name, arg) do { if (tr_on) tr_event(name, 'B', (long)(arg)); } while (0)
+#define tr_instant(name, arg) do { if (tr_on) tr_event(name, 'i', (long)(arg)); } while (0)
+
+#endif
@@ -0,0 +1,405 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <string.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+
+#include "versus.h"
+#include "logger.h"
+
+typedef enum {
+    VS_PING,                  // t1
+    VS_PONG,                  // t1 de volta, t2 chegada, t3 saída
+    VS_START,                 // Convite: música, semente, início
+    VS_ACK,
+    VS_REFUSE,                // Não temos a música
+    VS_SCORE,
+    VS_BUSY                   // No meio de uma música, convite recusado
+} VsType;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t type;
+    uint64_t t1, t2, t3;
+    uint64_t start_ns;        // No relógio de quem recebe o convite
+    uint32_t song_id;
+    uint32_t seed;
+    uint32_t nonce;           // Desempate de convites cruzados
+    uint32_t seq;             // Pontuações fora de ordem são descartadas
+    int32_t score;
+    int32_t misses;
+    uint32_t finished;
+    uint32_t reserved;
+} VsMsg;
+
+static int sock = -1;
+static struct sockaddr_storage peer_addr;
+static socklen_t peer_len = 0;
+static struct sockaddr_un local_addr;
+static bool (*song_known)(uint32_t song_id) = NULL;
+static uint32_t nonce;
+static bool inviting = false;
+static bool busy = false;     // Numa música (ou já combinada): convite novo leva BUSY
+
+// Último convite aceito: retransmissões só recebem outro ACK
+static bool start_pending = false;
+static uint32_t start_song, start_seed;
+static uint64_t start_at = 0;
+
+// Resposta esperada por vs_start: tipo e chave (t1 ou start_ns)
+static uint32_t await_type;
+static uint64_t await_key;
+static VsMsg reply;
+static uint64_t reply_ns;
+static bool replied = false;
+
+static VsPeer peer;
+static uint32_t report_seq = 0;
+static int last_score = -1, last_misses = -1;
+static bool last_finished = false;
+static uint64_t last_report_ns = 0;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void send_msg(VsMsg *m) {
+    m->magic = VS_MAGIC;
+    // Sem o outro lado no ar o envio falha; o jogo segue sozinho
+    sendto(sock, m, sizeof(*m), MSG_DONTWAIT, (struct sockaddr *)&peer_addr, peer_len);
+}
+
+static void new_round(void) {
+    memset(&peer, 0, sizeof(peer));
+    report_seq = 0;
+    last_score = last_misses = -1;
+    last_finished = false;
+    last_report_ns = 0;
+}
+
+static int open_udp(char *spec) {
+    char *local = strtok(spec, ":");
+    char *host = strtok(NULL, ":");
+    char *remote = strtok(NULL, ":");
+    if (local == NULL || host == NULL || remote == NULL) return -1;
+
+    struct addrinfo hints = { .ai_socktype = SOCK_DGRAM }, *ai;
+    int err = getaddrinfo(host, remote, &hints, &ai);
+    if (err != 0) {
+        lg_postf(LG_ERROR, 0, "Versus: %s: %s", host, gai_strerror(err));
+        return -1;
+    }
+    memcpy(&peer_addr, ai->ai_addr, ai->ai_addrlen);
+    peer_len = ai->ai_addrlen;
+    int family = ai->ai_family;
+    freeaddrinfo(ai);
+
+    sock = socket(family, SOCK_DGRAM, 0);
+    if (sock < 0) return -1;
+
+    struct sockaddr_storage addr;
+    memset(&addr, 0, sizeof(addr));
+    socklen_t len;
+    if (family == AF_INET6) {
+        struct sockaddr_in6 *a = (struct sockaddr_in6 *)&addr;
+        a->sin6_family = AF_INET6;
+        a->sin6_port = htons(atoi(local));
+        a->sin6_addr = in6addr_any;
+        len = sizeof(*a);
+    } else {
+        struct sockaddr_in *a = (struct sockaddr_in *)&addr;
+        a->sin_family = AF_INET;
+        a->sin_port = htons(atoi(local));
+        a->sin_addr.s_addr = htonl(INADDR_ANY);
+        len = sizeof(*a);
+    }
+    return bind(sock, (struct sockaddr *)&addr, len);
+}
+
+static int open_unix(char *spec) {
+    char *local = strtok(spec, ":");
+    char *remote = strtok(NULL, ":");
+    if (local == NULL || remote == NULL ||
+        strlen(local) >= sizeof(local_addr.sun_path) || strlen(remote) >= sizeof(local_addr.sun_path)) {
+        return -1;
+    }
+
+    struct sockaddr_un *p = (struct sockaddr_un *)&peer_addr;
+    p->sun_family = AF_UNIX;
+    strcpy(p->sun_path, remote);
+    peer_len = sizeof(*p);
+
+    sock = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (sock < 0) return -1;
+    local_addr.sun_family = AF_UNIX;
+    strcpy(local_addr.sun_path, local);
+    unlink(local);
+    return bind(sock, (struct sockaddr *)&local_addr, sizeof(local_addr));
+}
+
+// Abre o canal com o outro gabinete (NULL = GH_VERSUS). Sem destino o
+// modo fica desligado e o jogo é o de sempre. has_song diz se um convite
+// pode ser aceito
+int vs_open(const char *spec, bool (*has_song)(uint32_t song_id)) {
+    if (spec == NULL) spec = getenv("GH_VERSUS");
+    if (spec == NULL) return 0;
+
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s", spec);
+    memset(&peer_addr, 0, sizeof(peer_addr));
+    memset(&local_addr, 0, sizeof(local_addr));
+
+    int ret = -1;
+    if (strncmp(buf, "udp:", 4) == 0) ret = open_udp(buf + 4);
+    else if (strncmp(buf, "unix:", 5) == 0) ret = open_unix(buf + 5);
+    else errno = EINVAL;
+    if (ret < 0) {
+        lg_postf(LG_ERROR, errno, "Versus indisponivel (%s)", spec);
+        vs_close();
+        return -1;
+    }
+
+    song_known = has_song;
+    nonce = (uint32_t)getpid() * 2654435761u ^ (uint32_t)now_ns();
+    return 0;
+}
+
+void vs_close(void) {
+    if (sock >= 0) close(sock);
+    if (local_addr.sun_path[0]) unlink(local_addr.sun_path);
+    memset(&local_addr, 0, sizeof(local_addr));
+    sock = -1;
+}
+
+bool vs_enabled(void) {
+    return sock >= 0;
+}
+
+int vs_fd(void) {
+    return sock;
+}
+
+// Trata uma mensagem; true se chegou um convite novo
+static bool handle(const VsMsg *m, uint64_t recv_ns) {
+    VsMsg out;
+    memset(&out, 0, sizeof(out));
+
+    switch (m->type) {
+    case VS_PING:
+        out.type = VS_PONG;
+        out.t1 = m->t1;
+        out.t2 = recv_ns;
+        out.t3 = now_ns();
+        send_msg(&out);
+        return false;
+
+    case VS_PONG:
+    case VS_ACK:
+    case VS_REFUSE:
+    case VS_BUSY:
+        if ((m->type == VS_PONG) != (await_type == VS_PONG) ||
+            (m->type == VS_PONG ? m->t1 : m->start_ns) != await_key) {
+            return false;     // Atrasada, de uma tentativa anterior
+        }
+        reply = *m;
+        reply_ns = recv_ns;
+        replied = true;
+        return false;
+
+    case VS_START:
+        out.start_ns = m->start_ns;
+        if (m->start_ns == start_at && m->song_id == start_song) {
+            out.type = VS_ACK;
+            send_msg(&out);
+            return false;
+        }
+        // Fora do lobby não dá para entrar: responde na hora, sem mexer
+        // no placar da partida em andamento
+        if (busy) {
+            out.type = VS_BUSY;
+            send_msg(&out);
+            return false;
+        }
+        // Convites cruzados: vale o de maior nonce
+        if (inviting && m->nonce < nonce) return false;
+        if (song_known != NULL && !song_known(m->song_id)) {
+            out.type = VS_REFUSE;
+            send_msg(&out);
+            return false;
+        }
+        out.type = VS_ACK;
+        send_msg(&out);
+        start_pending = true;
+        start_song = m->song_id;
+        start_seed = m->seed;
+        start_at = m->start_ns;
+        new_round();
+        return true;
+
+    case VS_SCORE:
+        if (m->seq <= peer.seq) return false;
+        peer.seen = true;
+        peer.finished = m->finished != 0;
+        peer.score = m->score;
+        peer.misses = m->misses;
+        peer.seq = m->seq;
+        return false;
+    }
+    return false;
+}
+
+// Lê tudo o que chegou sem bloquear. Chamada quando o socket fica
+// legível; true se um convite novo espera por vs_take_start
+bool vs_service(void) {
+    bool wake = false;
+    VsMsg m;
+    while (sock >= 0 && recv(sock, &m, sizeof(m), MSG_DONTWAIT) == (ssize_t)sizeof(m)) {
+        if (m.magic == VS_MAGIC) wake |= handle(&m, now_ns());
+    }
+    return wake;
+}
+
+// Espera a resposta (PONG, ou ACK/REFUSE/BUSY) com a chave dada
+static bool await_reply(uint32_t type, uint64_t key, VsMsg *out, uint64_t *recv_ns) {
+    uint64_t deadline = now_ns() + VS_REPLY_MS * 1000000ull;
+    await_type = type;
+    await_key = key;
+    replied = false;
+    for (;;) {
+        vs_service();
+        if (replied) {
+            *out = reply;
+            *recv_ns = reply_ns;
+            return true;
+        }
+        if (start_pending) return false;
+
+        uint64_t now = now_ns();
+        if (now >= deadline) return false;
+        struct pollfd pfd = { .fd = sock, .events = POLLIN };
+        poll(&pfd, 1, (int)((deadline - now + 999999) / 1000000));
+    }
+}
+
+// Mede o relógio do outro e o convida para começar a música em start_ns
+// (nosso relógio). 0 se aceitou, 1 se um convite do outro chegou antes e
+// venceu (pegar com vs_take_start; inclusive um que já esperava), -1 se
+// não respondeu, recusou ou está ocupado
+int vs_start(uint32_t song_id, uint32_t seed, uint64_t start_ns, VsClock *clock) {
+    clock->rtt_ns = UINT64_MAX;
+    clock->offset_ns = 0;
+    if (start_pending) return 1;
+
+    for (int i = 0; i < VS_PINGS; i++) {
+        VsMsg m, r;
+        memset(&m, 0, sizeof(m));
+        m.type = VS_PING;
+        m.t1 = now_ns();
+        send_msg(&m);
+
+        uint64_t t4;
+        if (!await_reply(VS_PONG, m.t1, &r, &t4)) {
+            if (start_pending) return 1;
+            continue;
+        }
+        // Ida e volta sem o tempo parado do outro lado; o deslocamento
+        // supõe caminhos simétricos, daí ficar com a menor ida e volta
+        uint64_t rtt = (t4 - r.t1) - (r.t3 - r.t2);
+        if (rtt < clock->rtt_ns) {
+            clock->rtt_ns = rtt;
+            clock->offset_ns = ((int64_t)(r.t2 - r.t1) + (int64_t)(r.t3 - t4)) / 2;
+        }
+    }
+    if (clock->rtt_ns == UINT64_MAX) {
+        lg_warn("Versus: adversario nao responde");
+        return -1;
+    }
+
+    VsMsg m, r;
+    memset(&m, 0, sizeof(m));
+    m.type = VS_START;
+    m.start_ns = start_ns + clock->offset_ns;
+    m.song_id = song_id;
+    m.seed = seed;
+    m.nonce = nonce;
+
+    int ret = -1;
+    inviting = true;
+    for (int i = 0; i < VS_START_TRIES && ret < 0 && !start_pending; i++) {
+        uint64_t t;
+        send_msg(&m);
+        if (await_reply(VS_ACK, m.start_ns, &r, &t)) {
+            if (r.type == VS_REFUSE) {
+                lg_warn("Versus: adversario nao tem a musica");
+                break;
+            }
+            if (r.type == VS_BUSY) {
+                lg_warn("Versus: adversario ocupado em outra musica");
+                break;
+            }
+            ret = 0;
+        }
+    }
+    inviting = false;
+
+    if (start_pending) return 1;
+    if (ret == 0) new_round();
+    return ret;
+}
+
+bool vs_invited(void) {
+    return start_pending;
+}
+
+// O jogo marca quando está numa música (da contagem até o fim, inclusive
+// pausado): convites que chegarem nesse tempo recebem BUSY
+void vs_set_busy(bool on) {
+    busy = on;
+}
+
+// Convite aceito do outro gabinete, com o início no nosso relógio
+bool vs_take_start(uint32_t *song_id, uint32_t *seed, uint64_t *start_ns) {
+    if (!start_pending) return false;
+    start_pending = false;
+    *song_id = start_song;
+    *seed = start_seed;
+    *start_ns = start_at;
+    return true;
+}
+
+// Manda a pontuação quando muda, e de tempos em tempos mesmo sem mudar
+// para cobrir datagramas perdidos
+void vs_report(int score, int misses, bool finished) {
+    if (sock < 0) return;
+    uint64_t now = now_ns();
+    if (score == last_score && misses == last_misses && finished == last_finished &&
+        now - last_report_ns < VS_HEARTBEAT_NS) {
+        return;
+    }
+
+    VsMsg m;
+    memset(&m, 0, sizeof(m));
+    m.type = VS_SCORE;
+    m.seq = ++report_seq;
+    m.score = score;
+    m.misses = misses;
+    m.finished = finished;
+    send_msg(&m);
+
+    last_score = score;
+    last_misses = misses;
+    last_finished = finished;
+    last_report_ns = now;
+}
+
+const VsPeer *vs_peer(void) {
+    return &peer;
+}
@@ -0,0 +1,53 @@
+#ifndef VERSUS_H
+#define VERSUS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Modo versus: dois gabinetes (dois processos, no mesmo host ou não)
+// jogam a mesma partitura ao mesmo tempo e trocam pontuações. O destino
+// vem de GH_VERSUS:
+//
+//   udp:<porta local>:<host>:<porta remota>   ex.: udp:7001:127.0.0.1:7002
+//   unix:<socket local>:<socket remoto>       datagramas Unix
+//
+// Quem escolhe a música mede o relógio do outro no estilo NTP (vários
+// pings, fica o de menor ida e volta), marca um instante de início
+// VS_LEAD_NS à frente e manda esse instante já convertido para o relógio
+// monotônico do outro, junto com a semente do gerador de notas. As
+// mensagens vão na ordem de bytes do host: os gabinetes são da mesma
+// arquitetura.
+
+#define VS_MAGIC 0x31564847   // "GHV1"
+#define VS_PINGS 8            // Amostras da medida do relógio
+#define VS_REPLY_MS 200       // Espera por cada resposta
+#define VS_START_TRIES 5
+#define VS_LEAD_NS 1500000000ull // Do convite ao início da música
+#define VS_HEARTBEAT_NS 250000000ull // Reenvio da pontuação sem mudança
+
+typedef struct {
+    int64_t offset_ns;        // Relógio do outro menos o nosso
+    uint64_t rtt_ns;
+} VsClock;
+
+typedef struct {
+    bool seen;                // Já chegou alguma pontuação nesta música
+    bool finished;
+    int score;
+    int misses;
+    uint32_t seq;             // Muda a cada pontuação nova
+} VsPeer;
+
+int vs_open(const char *spec, bool (*has_song)(uint32_t song_id));
+void vs_close(void);
+bool vs_enabled(void);
+int vs_fd(void);
+bool vs_service(void);
+int vs_start(uint32_t song_id, uint32_t seed, uint64_t start_ns, VsClock *clock);
+bool vs_invited(void);
+void vs_set_busy(bool on);
+bool vs_take_start(uint32_t *song_id, uint32_t *seed, uint64_t *start_ns);
+void vs_report(int score, int misses, bool finished);
+const VsPeer *vs_peer(void);
+
+#endif